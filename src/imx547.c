@@ -16,24 +16,42 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/firmware.h>
 #include <linux/gpio.h>
 #include <linux/gpio/consumer.h>
 #include <linux/i2c.h>
 #include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/iopoll.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/of_gpio.h>
+#include <linux/pm_runtime.h>
+#include <linux/property.h>
 #include <linux/regmap.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/v4l2-mediabus.h>
 #include <linux/videodev2.h>
+#include <linux/workqueue.h>
 
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
+#include <media/v4l2-event.h>
 #include <media/v4l2-subdev.h>
 
 #include "imx547_mode_tbls.h"
+#include "imx547_timing.h"
+
+/* generic metadata codes, added to the UAPI headers in 6.10 */
+#ifndef MEDIA_BUS_FMT_META_10
+#define MEDIA_BUS_FMT_META_10   0x8002
+#endif
+#ifndef MEDIA_BUS_FMT_META_12
+#define MEDIA_BUS_FMT_META_12   0x8003
+#endif
 
 #define IMX547_K_FACTOR 1000LL
 #define IMX547_M_FACTOR 1000000LL
@@ -54,22 +72,184 @@
 #define IMX547_MAX_EXPOSURE_TIME    (660000)
 #define IMX547_DEF_EXPOSURE_TIME    (1000)
 
-// 10bit maximum 122.2 fps
-#define IMX547_MAX_FRAME_INTERVAL_10BIT_NUMERATOR   (5)
-#define IMX547_MAX_FRAME_INTERVAL_10BIT_DENOMINATOR (611)
-// 12bit maximum 82.4 fps
-#define IMX547_MAX_FRAME_INTERVAL_12BIT_NUMERATOR   (5)
-#define IMX547_MAX_FRAME_INTERVAL_12BIT_DENOMINATOR (412)
 #define IMX547_MIN_FRAME_RATE       (2)
 #define IMX547_DEF_FRAME_RATE       (60)
 
+/* hardware window (FID0 ROI area 1) limits */
+#define IMX547_CROP_ALIGN           4
+#define IMX547_MIN_CROP_WIDTH       256
+#define IMX547_MIN_CROP_HEIGHT      8
+
 #define IMX547_MIN_SHS_LENGTH_10BIT 54
 #define IMX547_MIN_SHS_LENGTH_12BIT 40
 
-#define IMX547_DEFAULT_LINE_TIME_10BIT 3700 // [ns]
-#define IMX547_DEFAULT_LINE_TIME_12BIT 5500 // [ns]
+// AD conversion floor of HMAX, 10bit maximum 122.3 fps, 12bit 82.4 fps
+#define IMX547_HMAX_10BIT   274
+#define IMX547_HMAX_12BIT   408
+#define IMX547_VMAX_10BIT   2216
+#define IMX547_VMAX_12BIT   2208
+
+/* HMAX and VMAX register widths, shortest vertical blanking at full height */
+#define IMX547_MAX_HMAX     0xFFFF
+#define IMX547_MAX_VMAX     0xFFFFF
+#define IMX547_MIN_VBLANK   144
+
+/* timing model pixel clock, one HMAX unit (INCK cycle) is 16 pixels */
+#define IMX547_PIXELS_PER_INCK  16
+#define IMX547_PIXEL_RATE       (IMX547_INCK * IMX547_PIXELS_PER_INCK)
+
+/* SLVS-EC lane bit rate, 32 x INCK */
+#define IMX547_LINK_FREQ        2376000000LL
+
+/* SLVS-EC lanes without a data-lanes property */
+#define IMX547_DEF_LANES        IMX547_MAX_LANES
+
+/*
+ * Register blocks tracked for delta programming. A dirty block is written
+ * in full, a clean one only where the regmap cache differs from the target.
+ */
+#define IMX547_DIRTY_COMMON     BIT(0)
+#define IMX547_DIRTY_MODE       BIT(1)
+#define IMX547_DIRTY_TIMING     BIT(2)
+#define IMX547_DIRTY_CTRLS      BIT(3)
+#define IMX547_DIRTY_ALL        (IMX547_DIRTY_COMMON | IMX547_DIRTY_MODE | \
+                                 IMX547_DIRTY_TIMING | IMX547_DIRTY_CTRLS)
+
+#define IMX547_DEF_WARM_STANDBY_MS  (10000)
+#define IMX547_DEF_AUTOSUSPEND_MS   (2000)
+
+/* register access after XCLR is released */
+#define IMX547_XCLR_DELAY_US        (20)
+
+/* Frame information lines sent ahead of the image, FINFO_HWIDTH wide */
+#define IMX547_FINFO_LINES          (1)
+
+/* Source pads, the frame information lines have their own */
+enum {
+    IMX547_PAD_IMAGE,
+    IMX547_PAD_FINFO,
+    IMX547_NUM_PADS,
+};
+
+/* Frame sync events kept per subscriber */
+#define IMX547_FRAME_SYNC_EVENTS    (8)
+
+/*
+ * Per-frame control queue: a ring of (exposure [us], gain, black level)
+ * tuples, one applied per frame while streaming. A tuple written during
+ * frame N is latched by REGHOLD at the start of frame N+1 and shows up
+ * in the image read out as frame N+2 at the earliest, the register
+ * tables can delay it further (see imx547_queue_delay()).
+ */
+#define IMX547_CID_BASE             (V4L2_CID_USER_BASE | 0x1000)
+#define IMX547_CID_FRAME_QUEUE      (IMX547_CID_BASE + 0)
+#define IMX547_CID_FRAME_QUEUE_DELAY (IMX547_CID_BASE + 1)
+
+#define IMX547_CID_TRIGGER_MODE     (IMX547_CID_BASE + 2)
+#define IMX547_CID_TRIGGER_DELAY    (IMX547_CID_BASE + 3)
+
+#define IMX547_QUEUE_TUPLE          3
+#define IMX547_QUEUE_MAX            16
+#define IMX547_QUEUE_MIN_DELAY      2
+
+/* sent once an asynchronous stream start has completed */
+#define IMX547_EVENT_STREAM_STARTED (V4L2_EVENT_PRIVATE_START + 0x547)
+
+/*
+ * sent when control queue tuples missed their frame, u.data holds the
+ * first missed frame sequence and the number of tuples as two u32
+ */
+#define IMX547_EVENT_QUEUE_MISSED   (V4L2_EVENT_PRIVATE_START + 0x548)
+
+static char *mode_pack;
+module_param(mode_pack, charp, 0444);
+MODULE_PARM_DESC(mode_pack,
+         "Mode pack firmware file, overrides the firmware-name DT property");
+
+static unsigned int warm_standby_ms = IMX547_DEF_WARM_STANDBY_MS;
+module_param(warm_standby_ms, uint, 0444);
+MODULE_PARM_DESC(warm_standby_ms,
+         "Time in ms the sensor stays in warm standby after stream stop (0 = disabled)");
+
+static bool async_stream_start;
+module_param(async_stream_start, bool, 0644);
+MODULE_PARM_DESC(async_stream_start,
+         "Return from stream on before the sensor is up and signal IMX547_EVENT_STREAM_STARTED");
+
+/*
+ * imx547 timing budget related structure
+ */
+enum imx547_budget {
+    IMX547_BUDGET_STABILIZATION,
+    IMX547_BUDGET_TABLE_SETTLE,
+    IMX547_BUDGET_GT_RESET,
+    IMX547_BUDGET_LINK_READY,
+    IMX547_BUDGET_STANDBY,
+    IMX547_BUDGET_STOP_SETTLE,
+    IMX547_BUDGET_NUM,
+};
+
+/*
+ * struct imx547_budget_desc - Per-board tunable wait
+ * @name: Name used for reporting
+ * @prop: Device tree property overriding the default, in microseconds
+ * @min_us: Datasheet minimum, DT values below it are raised to it
+ * @def_us: Default used when the property is absent
+ */
+struct imx547_budget_desc {
+    const char *name;
+    const char *prop;
+    u32 min_us;
+    u32 def_us;
+};
 
-#define IMX547_INCK 74250000LL
+static const struct imx547_budget_desc imx547_budgets[IMX547_BUDGET_NUM] = {
+    [IMX547_BUDGET_STABILIZATION] = {
+        /* internal regulator stabilization after STANDBY is cleared */
+        .name = "stabilization",
+        .prop = "framos,stabilization-us",
+        .min_us = 1138000,
+        .def_us = 1138000,
+    },
+    [IMX547_BUDGET_TABLE_SETTLE] = {
+        /* settle time after a register table has been written */
+        .name = "table-settle",
+        .prop = "framos,table-settle-us",
+        .min_us = 0,
+        .def_us = 10000,
+    },
+    [IMX547_BUDGET_GT_RESET] = {
+        /* GT TRX wizard reset pulse width */
+        .name = "gt-reset",
+        .prop = "framos,gt-reset-us",
+        .min_us = 1000,
+        .def_us = 20000,
+    },
+    [IMX547_BUDGET_LINK_READY] = {
+        /* timeout for the optional link ready gpio after the GT reset */
+        .name = "link-ready",
+        .prop = "framos,link-ready-timeout-us",
+        .min_us = 0,
+        .def_us = 100000,
+    },
+    [IMX547_BUDGET_STANDBY] = {
+        /*
+         * delay between STANDBY and XMSTA on stop, from the FRAMOS
+         * stop sequence: STANDBY, 10 ms, XMSTA, 30 ms
+         */
+        .name = "standby",
+        .prop = "framos,standby-us",
+        .min_us = 100,
+        .def_us = 10000,
+    },
+    [IMX547_BUDGET_STOP_SETTLE] = {
+        /* settle time after XMSTA, from the same stop sequence */
+        .name = "stop-settle",
+        .prop = "framos,stop-settle-us",
+        .min_us = 0,
+        .def_us = 30000,
+    },
+};
 
 static const struct of_device_id imx547_of_match[] = {
     { .compatible = "framos,imx547" },
@@ -77,10 +257,29 @@ static const struct of_device_id imx547_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, imx547_of_match);
 
+/*
+ * Register windows programmed by the driver: the named control registers
+ * and the analog settings above them. Nothing the driver accesses is
+ * updated by the sensor itself, so all of it is cached and no register is
+ * volatile; reads on the stream start path are served from the cache.
+ */
+static const struct regmap_range imx547_regmap_ranges[] = {
+    regmap_reg_range(0x3000, 0x3AFF),
+    regmap_reg_range(0x3E00, 0x4AFF),
+};
+
+static const struct regmap_access_table imx547_regmap_access = {
+    .yes_ranges = imx547_regmap_ranges,
+    .n_yes_ranges = ARRAY_SIZE(imx547_regmap_ranges),
+};
+
 static const struct regmap_config imx547_regmap_config = {
     .reg_bits = 16,
     .val_bits = 8,
-    .cache_type = REGCACHE_RBTREE,
+    .max_register = 0x4AFF,
+    .wr_table = &imx547_regmap_access,
+    .rd_table = &imx547_regmap_access,
+    .cache_type = REGCACHE_MAPLE,
 };
 
 /*
@@ -93,6 +292,38 @@ enum {
     TEST_PATTERN_GRADIATION_PATTERN,
 };
 
+/*
+ * imx547 trigger modes, values are written to TRIGMODE
+ */
+enum {
+    IMX547_TRIGGER_FREE_RUN = 0,
+    IMX547_TRIGGER_EDGE,
+    IMX547_TRIGGER_PULSE_WIDTH,
+};
+
+static const char * const trigger_qmenu[] = {
+    "Free Run",
+    "Edge (exposure from SHS)",
+    "Pulse Width",
+};
+
+/*
+ * struct imx547_format - Media bus format description
+ * @code: Media bus code
+ * @bit_depth: Bits per pixel
+ */
+struct imx547_format {
+    u32 code;
+    u32 bit_depth;
+};
+
+static const struct imx547_format imx547_formats[] = {
+    { MEDIA_BUS_FMT_SRGGB10_1X10, 10 },
+    { MEDIA_BUS_FMT_Y10_1X10, 10 },
+    { MEDIA_BUS_FMT_SRGGB12_1X12, 12 },
+    { MEDIA_BUS_FMT_Y12_1X12, 12 },
+};
+
 static const char * const tp_qmenu[] = {
     "No Pattern",
     "Sequence Pattern 1",
@@ -103,47 +334,247 @@ static const char * const tp_qmenu[] = {
 /*
  * struct imx547_ctrls - imx547 ctrl structure
  * @handler: V4L2 ctrl handler structure
- * @exposure: Pointer to exposure ctrl structure
+ * @exposure: Pointer to exposure ctrl structure, cluster master
  * @gain: Pointer to gain ctrl structure
- * @test_pattern: Pointer to test pattern ctrl structure
  * @black_level: Pointer to black level ctrl structure
+ * @vblank: Pointer to vertical blanking ctrl structure
+ * @test_pattern: Pointer to test pattern ctrl structure
+ * @trigger_mode: Pointer to trigger mode ctrl structure
+ * @trigger_delay: Pointer to trigger to readout delay ctrl structure
+ * @frame_queue: Pointer to per-frame control queue ctrl structure
+ * @queue_delay: Pointer to per-frame queue delay ctrl structure
+ * @hblank: Pointer to horizontal blanking ctrl structure
+ * @pixel_rate: Pointer to pixel rate ctrl structure
+ * @link_freq: Pointer to link frequency ctrl structure
  */
 struct imx547_ctrls {
     struct v4l2_ctrl_handler handler;
+    /* exposure, gain, black level and vblank form one cluster, keep them together */
     struct v4l2_ctrl *exposure;
     struct v4l2_ctrl *gain;
-    struct v4l2_ctrl *test_pattern;
     struct v4l2_ctrl *black_level;
+    struct v4l2_ctrl *vblank;
+    struct v4l2_ctrl *test_pattern;
+    struct v4l2_ctrl *trigger_mode;
+    struct v4l2_ctrl *trigger_delay;
+    struct v4l2_ctrl *frame_queue;
+    struct v4l2_ctrl *queue_delay;
+    struct v4l2_ctrl *hblank;
+    struct v4l2_ctrl *pixel_rate;
+    struct v4l2_ctrl *link_freq;
+};
+
+static const s64 imx547_link_freqs[] = {
+    IMX547_LINK_FREQ,
+};
+
+/*
+ * imx547 sensor mode related structures
+ */
+enum {
+    IMX547_MODE_10BIT = 0,
+    IMX547_MODE_12BIT,
+    IMX547_MODE_NUM,
+};
+
+/*
+ * struct imx547_mode - Sensor mode description
+ * @name: Mode name
+ * @bit_depth: ADC and output bit depth
+ * @regs: Mode register table
+ * @hmax: Minimum line length of the AD conversion in INCK cycles
+ * @vmax: Minimum frame length in lines, for the full window
+ * @min_shs: Minimum SHS in lines
+ * @max_black_level: Black level ctrl maximum, full scale of @bit_depth
+ * @def_black_level: Black level ctrl default
+ * @meta_code: Media bus code of the frame information lines
+ */
+struct imx547_mode {
+    const char *name;
+    u32 bit_depth;
+    const struct imx547_reg_table *regs;
+    u32 hmax;
+    u32 vmax;
+    u32 min_shs;
+    u32 max_black_level;
+    u32 def_black_level;
+    u32 meta_code;
 };
 
+static const struct imx547_mode imx547_builtin_modes[IMX547_MODE_NUM] = {
+    [IMX547_MODE_10BIT] = {
+        .name = "10bit",
+        .bit_depth = 10,
+        .regs = &imx547_10bit_mode,
+        .hmax = IMX547_HMAX_10BIT,
+        .vmax = IMX547_VMAX_10BIT,
+        .min_shs = IMX547_MIN_SHS_LENGTH_10BIT,
+        .max_black_level = IMX547_MAX_BLACK_LEVEL_10BIT,
+        .def_black_level = IMX547_DEF_BLACK_LEVEL_10BIT,
+        .meta_code = MEDIA_BUS_FMT_META_10,
+    },
+    [IMX547_MODE_12BIT] = {
+        .name = "12bit",
+        .bit_depth = 12,
+        .regs = &imx547_12bit_mode,
+        .hmax = IMX547_HMAX_12BIT,
+        .vmax = IMX547_VMAX_12BIT,
+        .min_shs = IMX547_MIN_SHS_LENGTH_12BIT,
+        .max_black_level = IMX547_MAX_BLACK_LEVEL_12BIT,
+        .def_black_level = IMX547_DEF_BLACK_LEVEL_12BIT,
+        .meta_code = MEDIA_BUS_FMT_META_12,
+    },
+};
+
+/*
+ * Mode pack firmware layout, all fields little endian:
+ *
+ *   struct imx547_fw_header
+ *   struct imx547_fw_section, followed by @size bytes of runs
+ *   ... repeated @num_sections times
+ *
+ * A run is a struct imx547_fw_run followed by @len values.
+ * Section type 0 replaces the built-in common settings, type N replaces
+ * the bit depth table and timing of mode N - 1 (IMX547_MODE_*). Timing
+ * fields are ignored for the common section. The maximum frame interval
+ * and line time are derived from hmax and vmax, their fields are unused.
+ */
+#define IMX547_FW_MAGIC     0x37343549 /* "I547" */
+#define IMX547_FW_VERSION   1
+
+#define IMX547_FW_COMMON        0
+#define IMX547_FW_SECTION_NUM   (1 + IMX547_MODE_NUM)
+
+struct imx547_fw_header {
+    __le32 magic;
+    __le16 version;
+    __le16 num_sections;
+} __packed;
+
+struct imx547_fw_section {
+    __le16 type;
+    __le16 num_runs;
+    __le32 size;
+    __le32 hmax;
+    __le32 vmax;
+    __le32 min_shs;
+    __le32 max_fi_numerator;
+    __le32 max_fi_denominator;
+    __le32 line_time;
+} __packed;
+
+struct imx547_fw_run {
+    __le16 addr;
+    __le16 len;
+} __packed;
+
 /*
  * struct stim547 - imx547 device structure
  * @sd: V4L2 subdevice structure
- * @pad: Media pad structure
+ * @pads: Media pad structures, indexed by IMX547_PAD_*
  * @client: Pointer to I2C client
  * @ctrls: imx547 control structure
  * @format: V4L2 media bus frame format structure
+ * @crop: Hardware readout window
  * @frame_interval: V4L2 frame interval structure
  * @regmap: Pointer to regmap structure
+ * @common: Common settings table, built-in or from the mode pack
+ * @modes: Sensor modes, built-in or from the mode pack
+ * @mode: Current sensor mode
+ * @pack_tables: Register tables loaded from the mode pack
  * @gt_trx_reset_gpio: Pointer to GT TRX wizard reset gpio
  * @pipe_reset_gpio: Pointer to input pipe reset gpio
+ * @link_ready_gpio: Pointer to optional GT link ready gpio
+ * @xclr_gpio: Pointer to optional sensor XCLR gpio
+ * @xvs_gpio: Pointer to optional gpio wired to the sensor XVS output
+ * @xvs_irq: Frame start interrupt from XVS, 0 if not wired
+ * @trigger_latency_us: Measured trigger to readout latency, 0 if not set
+ * @debugfs: Debugfs directory
  * @lock: Mutex structure
+ * @standby_work: Delayed work dropping a warm sensor to full standby
+ * @start_work: Delayed work completing an asynchronous stream start
+ * @stable_at: Time the internal regulators are stable after leaving standby
+ * @start_ts: Time the last stream start was requested
+ * @budget_us: Timing budgets in microseconds, indexed by enum imx547_budget
+ * @start_latency_us: Duration of the last stream start
+ * @stop_latency_us: Duration of the last stream stop
+ * @resume_ts: Time of the system resume restarting the stream, 0 if none
+ * @resume_latency_us: System resume to first frame of the last restart,
+ *                     measured at XVS or estimated without it
  * @frame_length: Frame length
- * @line_time: Line time in nanoseconds
+ * @hmax: Line length in INCK cycles
+ * @lanes: Number of SLVS-EC lanes
+ * @dirty: Register blocks whose hardware state is unknown (IMX547_DIRTY_*)
+ * @queue_work: Applies the next control queue tuple
+ * @frame_ns: Frame period in nanoseconds
+ * @queue: Control queue tuples
+ * @queue_len: Number of tuples in the control queue
+ * @queue_pos: Next tuple to apply
+ * @queue_next: Frame sequence the next tuple is meant for
+ * @queue_missed: Number of tuples that missed their frame
+ * @frame_sequence: Sequence number of the next frame sync event
+ * @hold_depth: Nesting depth of imx547_group_hold()
+ * @held: REGHOLD is set on the sensor
+ * @queue_running: Control queue is being applied
+ * @blanking_sync: VBLANK ctrl is being synced to the frame length
+ * @pm_stream: Streaming holds a runtime PM reference
+ * @resume_stream: Streaming was stopped by system suspend
+ * @streaming: Sensor is streaming
+ * @warm: Sensor is out of STANDBY and stopped by XMSTA only
+ * @start_pending: Asynchronous stream start is in progress
  */
 struct stimx547 {
     struct v4l2_subdev sd;
-    struct media_pad pad;
+    struct media_pad pads[IMX547_NUM_PADS];
     struct i2c_client *client;
     struct imx547_ctrls ctrls;
     struct v4l2_mbus_framefmt format;
+    struct v4l2_rect crop;
     struct v4l2_fract frame_interval;
     struct regmap *regmap;
+    const struct imx547_reg_table *common;
+    struct imx547_mode modes[IMX547_MODE_NUM];
+    const struct imx547_mode *mode;
+    struct imx547_reg_table pack_tables[IMX547_FW_SECTION_NUM];
     struct gpio_desc *gt_trx_reset_gpio;
     struct gpio_desc *pipe_reset_gpio;
+    struct gpio_desc *link_ready_gpio;
+    struct gpio_desc *xclr_gpio;
+    struct gpio_desc *xvs_gpio;
+    int xvs_irq;
+    u32 trigger_latency_us;
+    struct dentry *debugfs;
     struct mutex lock; /* mutex lock for operations */
+    struct delayed_work standby_work;
+    struct delayed_work start_work;
+    ktime_t stable_at;
+    ktime_t start_ts;
+    u32 budget_us[IMX547_BUDGET_NUM];
+    u32 start_latency_us;
+    u32 stop_latency_us;
+    ktime_t resume_ts;
+    u32 resume_latency_us;
     u64 frame_length;
-    u32 line_time;
+    u32 hmax;
+    u32 lanes;
+    u32 dirty;
+    struct work_struct queue_work;
+    u64 frame_ns;
+    u32 queue[IMX547_QUEUE_MAX][IMX547_QUEUE_TUPLE];
+    unsigned int queue_len;
+    unsigned int queue_pos;
+    u32 queue_next;
+    u32 queue_missed;
+    u32 frame_sequence;
+    unsigned int hold_depth;
+    bool held;
+    bool queue_running;
+    bool blanking_sync;
+    bool pm_stream;
+    bool resume_stream;
+    bool streaming;
+    bool warm;
+    bool start_pending;
 };
 
 /*
@@ -154,11 +585,24 @@ static int imx547_set_exposure(struct stimx547 *priv, int val);
 static int imx547_set_test_pattern(struct stimx547 *priv, int val);
 static int imx547_set_black_level(struct stimx547 *priv, int val);
 static int imx547_set_frame_interval(struct stimx547 *priv);
-static int imx547_calculate_line_time(struct stimx547 *priv);
+static int imx547_set_frame_length(struct stimx547 *priv);
+static int imx547_set_vblank(struct stimx547 *priv, int val);
+static int imx547_set_hmax(struct stimx547 *priv);
+static int imx547_set_window(struct stimx547 *priv);
+static int imx547_update_exposure_range(struct stimx547 *priv);
+static int imx547_sync_exposure(struct stimx547 *priv);
 
-static inline void msleep_range(unsigned int delay_base)
+/*
+ * imx547_budget_wait - Sleep for a timing budget
+ * @priv: Pointer to device structure
+ * @budget: Budget to wait for
+ */
+static void imx547_budget_wait(struct stimx547 *priv, enum imx547_budget budget)
 {
-    usleep_range(delay_base * 1000, delay_base * 1000 + 500);
+    u32 us = priv->budget_us[budget];
+
+    if (us)
+        fsleep(us);
 }
 
 /*
@@ -175,67 +619,93 @@ static inline struct stimx547 *to_imx547(struct v4l2_subdev *sd)
     return container_of(sd, struct stimx547, sd);
 }
 
+/*
+ * imx547_cached_eq - Check a register against the regmap cache
+ * @priv: Pointer to device
+ * @addr: Register address
+ * @val: Expected value
+ *
+ * Only used on registers of clean blocks, which are always cached.
+ *
+ * Return: true if the cached value equals @val
+ */
+static bool imx547_cached_eq(struct stimx547 *priv, u16 addr, u8 val)
+{
+    unsigned int cur;
+
+    return !regmap_read(priv->regmap, addr, &cur) && cur == val;
+}
+
 /*
  * Writing a register table
  *
  * @priv: Pointer to device
- * @table: Table containing register values (with optional delays)
+ * @table: Table of register runs
+ * @block: Register block the table belongs to (IMX547_DIRTY_*)
  *
  * This is used to write register table into sensor's reg map.
+ * Each run goes out as one bulk write, split by regmap only where the
+ * adapter limits the transfer size. If the block is clean, each run is
+ * narrowed to the span whose cached values differ from the table.
  *
- * Return: 0 on success, errors otherwise
+ * Return: number of registers written, errors otherwise
  */
-static int imx547_write_table(struct stimx547 *priv, const struct reg_8 table[])
+static int imx547_write_table(struct stimx547 *priv,
+                  const struct imx547_reg_table *table, u32 block)
 {
-    struct regmap *regmap = priv->regmap;
-    int err = 0;
-    const struct reg_8 *next;
-    u8 val;
-
-    int range_start = -1;
-    int range_count = 0;
-    u8 range_vals[16];
-    int max_range_vals = ARRAY_SIZE(range_vals);
-
-    for (next = table;; next++) {
-        if ((next->addr != range_start + range_count) ||
-            (next->addr == IMX547_TABLE_END) ||
-            (next->addr == IMX547_TABLE_WAIT_MS) ||
-            (range_count == max_range_vals)) {
-            if (range_count == 1)
-                err = regmap_write(regmap,
-                           range_start, range_vals[0]);
-            else if (range_count > 1)
-                err = regmap_bulk_write(regmap, range_start,
-                            &range_vals[0],
-                            range_count);
-            else
-                err = 0;
-
-            if (err)
-                return err;
-
-            range_start = -1;
-            range_count = 0;
-
-            /* Handle special address values */
-            if (next->addr == IMX547_TABLE_END)
-                break;
-
-            if (next->addr == IMX547_TABLE_WAIT_MS) {
-                msleep_range(next->val);
+    bool delta = !(priv->dirty & block);
+    const struct imx547_reg_run *run;
+    unsigned int i, first, last;
+    int written = 0;
+    int err;
+
+    for (i = 0; i < table->num_runs; i++) {
+        run = &table->runs[i];
+        first = 0;
+        last = run->len;
+
+        if (delta) {
+            while (first < last &&
+                   imx547_cached_eq(priv, run->addr + first, run->vals[first]))
+                first++;
+            while (last > first &&
+                   imx547_cached_eq(priv, run->addr + last - 1, run->vals[last - 1]))
+                last--;
+            if (first == last)
                 continue;
-            }
         }
 
-        val = next->val;
-
-        if (range_start == -1)
-            range_start = next->addr;
+        if (last - first == 1)
+            err = regmap_write(priv->regmap, run->addr + first,
+                       run->vals[first]);
+        else
+            err = regmap_bulk_write(priv->regmap, run->addr + first,
+                        &run->vals[first], last - first);
+        if (err)
+            return err;
 
-        range_vals[range_count++] = val;
+        written += last - first;
     }
-    return 0;
+
+    return written;
+}
+
+/*
+ * imx547_table_xfers - Count the I2C transactions of a full table write
+ * @table: Table of register runs
+ * @max_burst: Largest write the adapter accepts in bytes, 0 if unlimited
+ *
+ * Return: number of transactions
+ */
+static unsigned int imx547_table_xfers(const struct imx547_reg_table *table,
+                       size_t max_burst)
+{
+    unsigned int i, xfers = 0;
+
+    for (i = 0; i < table->num_runs; i++)
+        xfers += max_burst ? DIV_ROUND_UP(table->runs[i].len, max_burst) : 1;
+
+    return xfers;
 }
 
 static inline int imx547_write_reg(struct stimx547 *priv, u16 addr, u8 val)
@@ -254,41 +724,6 @@ static inline int imx547_write_reg(struct stimx547 *priv, u16 addr, u8 val)
     return err;
 }
 
-/**
- * Read a multibyte register.
- *
- * Uses a bulk read where possible.
- *
- * @priv: Pointer to device structure
- * @addr: Address of the LSB register.  Other registers must be
- *        consecutive, least-to-most significant.
- * @val: Pointer to store the register value (cpu endianness)
- * @nbytes: Number of bytes to read (range: [1..3]).
- *          Other bytes are zet to 0.
- *
- * Return: 0 on success, errors otherwise
- */
-static int imx547_read_mbreg(struct stimx547 *priv, u16 addr, u32 *val,
-                 size_t nbytes)
-{
-    __le32 val_le = 0;
-    int err;
-
-    err = regmap_bulk_read(priv->regmap, addr, &val_le, nbytes);
-    if (err) {
-        dev_err(&priv->client->dev,
-            "%s : i2c bulk read failed, %x (%zu bytes)\n",
-            __func__, addr, nbytes);
-    } else {
-        *val = le32_to_cpu(val_le);
-        dev_dbg(&priv->client->dev,
-            "%s : addr 0x%x, val=0x%x (%zu bytes)\n",
-            __func__, addr, *val, nbytes);
-    }
-
-    return err;
-}
-
 /**
  * Write a multibyte register.
  *
@@ -318,684 +753,3028 @@ static int imx547_write_mbreg(struct stimx547 *priv, u16 addr, u32 val,
     return err;
 }
 
+/**
+ * Update a multibyte register.
+ *
+ * Skips the write if the block is clean and the regmap cache already
+ * holds the value.
+ *
+ * @priv: Pointer to device structure
+ * @block: Register block the register belongs to (IMX547_DIRTY_*)
+ * @addr: Address of the LSB register
+ * @val: Value to be written to the register (cpu endianness)
+ * @nbytes: Number of bytes to write (range: [1..3])
+ */
+static int imx547_update_mbreg(struct stimx547 *priv, u32 block, u16 addr,
+                   u32 val, size_t nbytes)
+{
+    size_t i;
+
+    if (priv->dirty & block)
+        return imx547_write_mbreg(priv, addr, val, nbytes);
+
+    for (i = 0; i < nbytes; i++) {
+        if (!imx547_cached_eq(priv, addr + i, (val >> (8 * i)) & 0xFF))
+            return imx547_write_mbreg(priv, addr, val, nbytes);
+    }
+
+    return 0;
+}
+
 /*
- * imx547_common_regs - Function for setting common registers.
+ * imx547_group_hold - Start a group of register updates
  * @priv: Pointer to device structure
  *
+ * While streaming, sets REGHOLD so that everything written until the
+ * matching imx547_group_release() takes effect on the same frame.
+ * Calls nest, only the outermost pair touches REGHOLD.
+ * The caller should hold the mutex lock imx547->lock.
+ *
  * Return: 0 on success, errors otherwise
  */
-static int imx547_common_regs(struct stimx547 *priv)
+static int imx547_group_hold(struct stimx547 *priv)
 {
-    int err = 0;
+    int err;
 
-    err = imx547_write_table(priv, imx547_common_settings);
-    if (err)
+    if (priv->hold_depth++ || !priv->streaming)
+        return 0;
+
+    err = imx547_write_mbreg(priv, REGHOLD, 1, 1);
+    if (err) {
+        priv->hold_depth--;
         return err;
+    }
 
-    dev_dbg(&priv->client->dev, "imx547 : imx547_common_regs !\n");
+    priv->held = true;
 
-    return err;
+    return 0;
 }
 
 /*
- * imx547_set_pixel_format - Function for setting registers for pixel format.
+ * imx547_group_release - Commit a group of register updates
  * @priv: Pointer to device structure
  *
  * Return: 0 on success, errors otherwise
  */
-static int imx547_set_pixel_format(struct stimx547 *priv)
+static int imx547_group_release(struct stimx547 *priv)
 {
-    int err = 0;
+    if (--priv->hold_depth || !priv->held)
+        return 0;
 
-    switch (priv->format.code) {
-        case MEDIA_BUS_FMT_SRGGB10_1X10:
-        case MEDIA_BUS_FMT_Y10_1X10:
-            err = imx547_write_table(priv, imx547_10bit_mode);
-            break;
-        case MEDIA_BUS_FMT_SRGGB12_1X12:
-        case MEDIA_BUS_FMT_Y12_1X12:
-            err = imx547_write_table(priv, imx547_12bit_mode);
-            break;
-        default:
-            dev_err(&priv->client->dev, "%s: unknown pixel format\n", __func__);
-            return -EINVAL;
-    }
-    dev_dbg(&priv->client->dev, "imx547 : imx547_set_pixel_format !\n");
+    priv->held = false;
 
-    return err;
+    return imx547_write_mbreg(priv, REGHOLD, 0, 1);
 }
 
 /*
- * imx547_start_stream - Function for starting stream
+ * imx547_mark_regs_lost - Force a full rewrite on the next stream start
  * @priv: Pointer to device structure
  *
- * Return: 0 on success, errors otherwise
+ * Used after power loss, a reset or a failed write, when the regmap
+ * cache no longer mirrors the sensor.
  */
-static int imx547_start_stream(struct stimx547 *priv)
+static void imx547_mark_regs_lost(struct stimx547 *priv)
 {
-    int err = 0;
-
-    err = imx547_write_reg(priv, STANDBY, 0x00);
+    priv->dirty = IMX547_DIRTY_ALL;
+}
 
-    /* "Internal regulator stabilization" time */
-    usleep_range(1138000, 1140000);
+/*
+ * imx547_common_regs - Function for setting common registers.
+ * @priv: Pointer to device structure
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_common_regs(struct stimx547 *priv)
+{
+    int written, err;
+
+    written = imx547_write_table(priv, priv->common,
+                     IMX547_DIRTY_COMMON);
+    if (written < 0)
+        return written;
+
+    /* lane count, lanes not routed on the board stay in standby */
+    err = imx547_update_mbreg(priv, IMX547_DIRTY_COMMON, LANESEL,
+                  ilog2(priv->lanes), 1);
+    if (!err)
+        err = imx547_update_mbreg(priv, IMX547_DIRTY_COMMON, STBSLVS,
+                      IMX547_STBSLVS_LANES &
+                      ~GENMASK(priv->lanes - 1, 0), 1);
+    if (err)
+        return err;
 
-    gpiod_set_value_cansleep(priv->gt_trx_reset_gpio, 1);
-    usleep_range(20000, 21000);
-    gpiod_set_value_cansleep(priv->gt_trx_reset_gpio, 0);
+    if (written)
+        imx547_budget_wait(priv, IMX547_BUDGET_TABLE_SETTLE);
 
-    err |= imx547_write_reg(priv, XMSTA, 0x00);
+    dev_dbg(&priv->client->dev, "imx547 : imx547_common_regs, %d written !\n",
+        written);
 
-    dev_dbg(&priv->client->dev, "imx547 : imx547_start_stream !\n");
     return 0;
 }
 
 /*
- * imx547_stop_stream - Function for stoping stream
+ * imx547_set_pixel_format - Function for setting registers for pixel format.
  * @priv: Pointer to device structure
  *
  * Return: 0 on success, errors otherwise
  */
-static int imx547_stop_stream(struct stimx547 *priv)
+static int imx547_set_pixel_format(struct stimx547 *priv)
 {
-    int err = 0;
+    int written;
 
-    err = imx547_write_reg(priv, STANDBY, 0x01);
+    written = imx547_write_table(priv, priv->mode->regs, IMX547_DIRTY_MODE);
+    if (written < 0)
+        return written;
 
-    usleep_range(100, 110);
-       
-    err |= imx547_write_reg(priv, XMSTA, 0x01);
+    if (written)
+        imx547_budget_wait(priv, IMX547_BUDGET_TABLE_SETTLE);
 
+    dev_dbg(&priv->client->dev, "imx547 : imx547_set_pixel_format, %d written !\n",
+        written);
 
-    dev_dbg(&priv->client->dev, "imx547 : imx547_stop_stream !\n");
     return 0;
 }
 
-
-/**
- * imx547_s_ctrl - This is used to set the imx547 V4L2 controls
- * @ctrl: V4L2 control to be set
+/*
+ * imx547_release_standby - Function for leaving full standby
+ * @priv: Pointer to device structure
  *
- * This function is used to set the V4L2 controls for the imx547 sensor.
+ * Clears STANDBY if the sensor is not already warm and records when the
+ * internal regulators will be stable.
+ * The caller should hold the mutex lock imx547->lock if necessary
  *
  * Return: 0 on success, errors otherwise
  */
-static int imx547_s_ctrl(struct v4l2_ctrl *ctrl)
+static int imx547_release_standby(struct stimx547 *priv)
 {
-    struct v4l2_subdev *sd = ctrl_to_sd(ctrl);
-    struct stimx547 *imx547 = to_imx547(sd);
-    int ret = -EINVAL;
+    int err;
 
-    dev_dbg(&imx547->client->dev,
-        "%s : s_ctrl: %s, value: %d\n", __func__,
-        ctrl->name, ctrl->val);
+    /* a pending drop to standby must not hit the starting sensor */
+    cancel_delayed_work(&priv->standby_work);
 
-    switch (ctrl->id) {
-    case V4L2_CID_EXPOSURE:
-        dev_dbg(&imx547->client->dev,
-            "%s : set V4L2_CID_EXPOSURE\n", __func__);
-        ret = imx547_set_exposure(imx547, ctrl->val);
-        break;
+    if (priv->warm) {
+        /* regulators are up, only the remaining stabilization time is left */
+        dev_dbg(&priv->client->dev, "%s: restart from warm standby\n", __func__);
+        return 0;
+    }
 
-    case V4L2_CID_GAIN:
-        dev_dbg(&imx547->client->dev,
-            "%s : set V4L2_CID_GAIN\n", __func__);
-        ret = imx547_set_gain(imx547, ctrl->val);
-        break;
+    err = imx547_write_reg(priv, STANDBY, 0x00);
+    if (err)
+        return err;
 
-    case V4L2_CID_TEST_PATTERN:
-        dev_dbg(&imx547->client->dev,
-            "%s : set V4L2_CID_TEST_PATTERN\n", __func__);
-        ret = imx547_set_test_pattern(imx547, ctrl->val);
-        break;
+    /* "Internal regulator stabilization" time */
+    priv->stable_at = ktime_add_us(ktime_get(),
+                       priv->budget_us[IMX547_BUDGET_STABILIZATION]);
+    priv->warm = true;
 
-    case V4L2_CID_BLACK_LEVEL:
-        dev_dbg(&imx547->client->dev,
-            "%s : set V4L2_CID_BLACK_LEVEL\n", __func__);
-        ret = imx547_set_black_level(imx547, ctrl->val);
-        break;
+    return 0;
+}
 
-    }
+/*
+ * imx547_stabilization_left - Remaining regulator stabilization time
+ * @priv: Pointer to device structure
+ *
+ * Return: remaining time in microseconds, 0 when stable
+ */
+static s64 imx547_stabilization_left(struct stimx547 *priv)
+{
+    s64 left = ktime_us_delta(priv->stable_at, ktime_get());
 
-    return ret;
+    return left > 0 ? left : 0;
 }
 
-
-/**
- * imx547_get_fmt - Get the pad format
- * @sd: Pointer to V4L2 Sub device structure
- * @cfg: Pointer to sub device pad information structure
- * @fmt: Pointer to pad level media bus format
+/*
+ * imx547_gt_trx_reset - Pulse the GT TRX wizard reset
+ * @priv: Pointer to device structure
  *
- * This function is used to get the pad format information.
+ * When the board provides a link ready gpio, it is polled after the
+ * reset pulse instead of relying on the pulse width alone.
+ * Only touches gpios, so it may be called without imx547->lock held.
  *
- * Return: 0 on success
+ * Return: 0 on success, -ETIMEDOUT if the link did not come up
  */
-static int imx547_get_fmt(struct v4l2_subdev *sd,
-              struct v4l2_subdev_state *sd_state,
+static int imx547_gt_trx_reset(struct stimx547 *priv)
+{
+    int ready;
+    int err;
+
+    gpiod_set_value_cansleep(priv->gt_trx_reset_gpio, 1);
+    imx547_budget_wait(priv, IMX547_BUDGET_GT_RESET);
+    gpiod_set_value_cansleep(priv->gt_trx_reset_gpio, 0);
+
+    if (!priv->link_ready_gpio)
+        return 0;
+
+    err = read_poll_timeout(gpiod_get_value_cansleep, ready, ready > 0,
+                100, priv->budget_us[IMX547_BUDGET_LINK_READY],
+                false, priv->link_ready_gpio);
+    if (err)
+        dev_err(&priv->client->dev, "%s: GT link not ready after %u us\n",
+            __func__, priv->budget_us[IMX547_BUDGET_LINK_READY]);
+
+    return err;
+}
+
+/*
+ * imx547_report_start - Record the stream start latency
+ * @priv: Pointer to device structure
+ */
+static void imx547_report_start(struct stimx547 *priv)
+{
+    priv->start_latency_us = ktime_us_delta(ktime_get(), priv->start_ts);
+
+    dev_dbg(&priv->client->dev, "%s: stream start took %u us\n",
+        __func__, priv->start_latency_us);
+
+    /* with XVS the first frame start is measured by imx547_xvs_irq() */
+    if (!priv->resume_ts || priv->xvs_irq)
+        return;
+
+    /*
+     * Upper bound: the sensor starts the first frame at the master start
+     * and it is out one frame period later.
+     */
+    priv->resume_latency_us = ktime_us_delta(ktime_get(), priv->resume_ts) +
+                  div_u64(priv->frame_ns, IMX547_K_FACTOR);
+    priv->resume_ts = 0;
+
+    dev_dbg(&priv->client->dev, "%s: resume to first frame at most %u us\n",
+        __func__, priv->resume_latency_us);
+}
+
+/*
+ * imx547_queue_start - Start applying the control queue
+ * @priv: Pointer to device structure
+ *
+ * The caller should hold the mutex lock imx547->lock.
+ */
+static void imx547_queue_start(struct stimx547 *priv)
+{
+    if (!priv->streaming || !priv->queue_len)
+        return;
+
+    priv->queue_pos = 0;
+    /* the next XVS interrupt applies the first tuple */
+    priv->queue_next = READ_ONCE(priv->frame_sequence);
+    WRITE_ONCE(priv->queue_running, true);
+}
+
+/*
+ * imx547_queue_stop - Stop applying the control queue
+ * @priv: Pointer to device structure
+ *
+ * The queue leaves the sensor at its last tuple, so the control values
+ * are rewritten on the next stream start.
+ * The caller should hold the mutex lock imx547->lock.
+ */
+static void imx547_queue_stop(struct stimx547 *priv)
+{
+    if (!priv->queue_running)
+        return;
+
+    WRITE_ONCE(priv->queue_running, false);
+    priv->dirty |= IMX547_DIRTY_CTRLS;
+}
+
+/*
+ * imx547_xvs_irq - Frame start interrupt from the sensor XVS output
+ * @irq: Interrupt number
+ * @data: Pointer to device structure
+ *
+ * Runs in hard interrupt context where the GPIO controller allows it, so
+ * the event timestamp is taken at the frame start. Behind a GPIO expander
+ * with nested threaded interrupts it runs in the expander's thread. The
+ * handler does not sleep, so both work.
+ *
+ * Return: IRQ_HANDLED
+ */
+static irqreturn_t imx547_xvs_irq(int irq, void *data)
+{
+    struct stimx547 *priv = data;
+    struct v4l2_event ev = {
+        .type = V4L2_EVENT_FRAME_SYNC,
+    };
+    ktime_t resume_ts;
+    u32 seq;
+
+    if (!READ_ONCE(priv->streaming))
+        return IRQ_HANDLED;
+
+    seq = priv->frame_sequence++;
+    ev.u.frame_sync.frame_sequence = seq;
+    v4l2_event_queue(priv->sd.devnode, &ev);
+
+    /* first frame of a stream restarted by system resume */
+    resume_ts = READ_ONCE(priv->resume_ts);
+    if (!seq && resume_ts) {
+        priv->resume_latency_us = ktime_us_delta(ktime_get(), resume_ts);
+        WRITE_ONCE(priv->resume_ts, 0);
+    }
+
+    if (READ_ONCE(priv->queue_running))
+        queue_work(system_highpri_wq, &priv->queue_work);
+
+    return IRQ_HANDLED;
+}
+
+/*
+ * imx547_apply_tuple - Write exposure, gain and black level on one frame
+ * @priv: Pointer to device structure
+ * @tuple: Exposure [us], gain and black level
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_apply_tuple(struct stimx547 *priv, const u32 *tuple)
+{
+    int err, ret;
+
+    err = imx547_group_hold(priv);
+    if (err)
+        return err;
+
+    err = imx547_set_exposure(priv, tuple[0]);
+    if (!err)
+        err = imx547_set_gain(priv, tuple[1]);
+    if (!err)
+        err = imx547_set_black_level(priv, tuple[2]);
+
+    ret = imx547_group_release(priv);
+
+    return err ? err : ret;
+}
+
+/*
+ * imx547_queue_missed - Report control queue tuples that missed their frame
+ * @priv: Pointer to device structure
+ * @sequence: Frame sequence of the first missed tuple
+ * @count: Number of missed tuples
+ */
+static void imx547_queue_missed(struct stimx547 *priv, u32 sequence, u32 count)
+{
+    struct v4l2_event ev = {
+        .type = IMX547_EVENT_QUEUE_MISSED,
+    };
+    u32 data[2] = { sequence, count };
+
+    priv->queue_missed += count;
+    memcpy(ev.u.data, data, sizeof(data));
+    v4l2_event_queue(priv->sd.devnode, &ev);
+
+    dev_dbg(&priv->client->dev, "%s: %u tuples missed from frame %u\n",
+        __func__, count, sequence);
+}
+
+/*
+ * imx547_queue_work - Apply the next control queue tuple
+ * @work: Pointer to work structure
+ *
+ * The tuple is meant for the frame whose XVS queued the work. Work queued
+ * again while pending, or delayed by the lock, covers several frames.
+ * The tuples of the frames already gone are skipped, so that the queue
+ * stays aligned to the frame sequence, and reported as missed. A frame
+ * start during the write also loses the tuple.
+ */
+static void imx547_queue_work(struct work_struct *work)
+{
+    struct stimx547 *priv = container_of(work, struct stimx547, queue_work);
+    u32 seq, cur, late;
+    int err;
+
+    mutex_lock(&priv->lock);
+    if (!priv->streaming || !priv->queue_len || !priv->queue_running)
+        goto unlock;
+
+    /* frame started by the last XVS */
+    seq = READ_ONCE(priv->frame_sequence);
+    cur = seq - 1;
+    late = cur - priv->queue_next;
+    if ((s32)late < 0)
+        goto unlock;
+
+    if (late) {
+        imx547_queue_missed(priv, priv->queue_next, late);
+        priv->queue_pos = (priv->queue_pos + late) % priv->queue_len;
+    }
+
+    err = imx547_apply_tuple(priv, priv->queue[priv->queue_pos]);
+    if (err)
+        goto fail;
+
+    if (READ_ONCE(priv->frame_sequence) != seq)
+        imx547_queue_missed(priv, cur, 1);
+
+    priv->queue_pos = (priv->queue_pos + 1) % priv->queue_len;
+    priv->queue_next = cur + 1;
+    goto unlock;
+
+fail:
+    dev_err(&priv->client->dev, "%s: control queue stopped (%d)\n",
+        __func__, err);
+    imx547_queue_stop(priv);
+unlock:
+    mutex_unlock(&priv->lock);
+}
+
+/*
+ * imx547_try_queue - Validate new per-frame control queue tuples
+ * @priv: Pointer to device structure
+ * @ctrl: Frame queue control holding the new tuples
+ *
+ * Fewer than three values clear the queue, longer arrays have to hold
+ * whole tuples.
+ *
+ * Return: 0 on success, -EINVAL for a partial tuple, -ERANGE for a gain
+ * or black level out of the control range
+ */
+static int imx547_try_queue(struct stimx547 *priv, struct v4l2_ctrl *ctrl)
+{
+    struct imx547_ctrls *ctrls = &priv->ctrls;
+    const u32 *vals = ctrl->p_new.p_u32;
+    unsigned int i, len;
+
+    if (ctrl->new_elems >= IMX547_QUEUE_TUPLE &&
+        ctrl->new_elems % IMX547_QUEUE_TUPLE)
+        return -EINVAL;
+
+    len = ctrl->new_elems / IMX547_QUEUE_TUPLE;
+    for (i = 0; i < len; i++, vals += IMX547_QUEUE_TUPLE) {
+        if (vals[1] < ctrls->gain->minimum || vals[1] > ctrls->gain->maximum ||
+            vals[2] < ctrls->black_level->minimum ||
+            vals[2] > ctrls->black_level->maximum)
+            return -ERANGE;
+    }
+
+    return 0;
+}
+
+/*
+ * imx547_set_queue - Replace the per-frame control queue
+ * @priv: Pointer to device structure
+ * @ctrl: Frame queue control holding the new tuples, checked by
+ *        imx547_try_queue()
+ *
+ * Fewer than three values clear the queue and restore the control values.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_set_queue(struct stimx547 *priv, struct v4l2_ctrl *ctrl)
+{
+    struct imx547_ctrls *ctrls = &priv->ctrls;
+    unsigned int len = ctrl->new_elems / IMX547_QUEUE_TUPLE;
+    u32 cur[IMX547_QUEUE_TUPLE];
+
+    imx547_queue_stop(priv);
+    memcpy(priv->queue, ctrl->p_new.p_u32,
+           len * IMX547_QUEUE_TUPLE * sizeof(u32));
+    priv->queue_len = len;
+
+    if (len) {
+        imx547_queue_start(priv);
+        return 0;
+    }
+
+    if (!priv->streaming || !(priv->dirty & IMX547_DIRTY_CTRLS))
+        return 0;
+
+    /* queue cleared while streaming, go back to the control values */
+    cur[0] = ctrls->exposure->cur.val;
+    cur[1] = ctrls->gain->cur.val;
+    cur[2] = ctrls->black_level->cur.val;
+
+    return imx547_apply_tuple(priv, cur);
+}
+
+/*
+ * imx547_master_start - Function for releasing master stop
+ * @priv: Pointer to device structure
+ *
+ * The caller should hold the mutex lock imx547->lock if necessary
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_master_start(struct stimx547 *priv)
+{
+    int err;
+
+    err = imx547_write_reg(priv, XMSTA, 0x00);
+    if (err)
+        return err;
+
+    priv->start_pending = false;
+    priv->frame_sequence = 0;
+    WRITE_ONCE(priv->streaming, true);
+    imx547_queue_start(priv);
+
+    return 0;
+}
+
+/*
+ * imx547_enter_standby - Function for putting the sensor into full standby
+ * @priv: Pointer to device structure
+ *
+ * The caller should hold the mutex lock imx547->lock if necessary
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_enter_standby(struct stimx547 *priv)
+{
+    int err;
+
+    imx547_queue_stop(priv);
+
+    priv->warm = false;
+    WRITE_ONCE(priv->streaming, false);
+    priv->start_pending = false;
+
+    err = imx547_write_reg(priv, STANDBY, 0x01);
+    if (err)
+        return err;
+
+    imx547_budget_wait(priv, IMX547_BUDGET_STANDBY);
+
+    err = imx547_write_reg(priv, XMSTA, 0x01);
+    if (err)
+        return err;
+
+    imx547_budget_wait(priv, IMX547_BUDGET_STOP_SETTLE);
+
+    return 0;
+}
+
+/*
+ * imx547_start_stream - Function for starting stream
+ * @priv: Pointer to device structure
+ *
+ * Blocks until the sensor is streaming, with imx547->lock held.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_start_stream(struct stimx547 *priv)
+{
+    int err;
+    s64 left;
+
+    err = imx547_release_standby(priv);
+    if (err)
+        return err;
+
+    left = imx547_stabilization_left(priv);
+    if (left)
+        usleep_range(left, left + 2000);
+
+    err = imx547_gt_trx_reset(priv);
+    if (err)
+        return err;
+
+    err = imx547_master_start(priv);
+    if (err)
+        return err;
+
+    imx547_report_start(priv);
+
+    dev_dbg(&priv->client->dev, "imx547 : imx547_start_stream !\n");
+    return 0;
+}
+
+/*
+ * imx547_start_stream_async - Function for starting stream in the background
+ * @priv: Pointer to device structure
+ *
+ * Leaves standby and hands the stabilization wait, the GT TRX reset pulse
+ * and the master start to start_work. IMX547_EVENT_STREAM_STARTED is sent
+ * once the sensor is streaming.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_start_stream_async(struct stimx547 *priv)
+{
+    int err;
+
+    err = imx547_release_standby(priv);
+    if (err)
+        return err;
+
+    priv->start_pending = true;
+    mod_delayed_work(system_wq, &priv->start_work,
+             usecs_to_jiffies(imx547_stabilization_left(priv)));
+
+    dev_dbg(&priv->client->dev, "imx547 : imx547_start_stream_async !\n");
+    return 0;
+}
+
+/*
+ * imx547_start_work - Complete an asynchronous stream start
+ * @work: Pointer to work structure
+ *
+ * imx547->lock is dropped during the stabilization wait, so controls and
+ * format queries are served while it lasts. The GT TRX reset pulse and
+ * the master start run under the lock and cannot overlap a synchronous
+ * start. imx547_s_stream() cancels the work before it takes the lock.
+ */
+static void imx547_start_work(struct work_struct *work)
+{
+    struct stimx547 *priv = container_of(to_delayed_work(work),
+                         struct stimx547, start_work);
+    struct v4l2_event ev = {
+        .type = IMX547_EVENT_STREAM_STARTED,
+    };
+    bool started = false;
+    s64 left;
+    int err;
+
+    mutex_lock(&priv->lock);
+    if (!priv->start_pending)
+        goto unlock;
+
+    left = imx547_stabilization_left(priv);
+    if (left) {
+        /* woken early, wait for the rest */
+        mod_delayed_work(system_wq, &priv->start_work, usecs_to_jiffies(left));
+        goto unlock;
+    }
+
+    err = imx547_gt_trx_reset(priv);
+    if (!err)
+        err = imx547_master_start(priv);
+
+    if (err) {
+        dev_err(&priv->client->dev, "%s: stream start failed (%d)\n",
+            __func__, err);
+        imx547_enter_standby(priv);
+        imx547_mark_regs_lost(priv);
+    } else {
+        started = true;
+        imx547_report_start(priv);
+    }
+
+unlock:
+    mutex_unlock(&priv->lock);
+
+    if (started) {
+        v4l2_subdev_notify_event(&priv->sd, &ev);
+        dev_dbg(&priv->client->dev, "%s: stream started\n", __func__);
+    }
+}
+
+/*
+ * imx547_stop_stream - Function for stoping stream
+ * @priv: Pointer to device structure
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_stop_stream(struct stimx547 *priv)
+{
+    int err = 0;
+    unsigned int warm_ms = warm_standby_ms;
+    ktime_t stop_ts = ktime_get();
+
+    /* a restart stopped before its first frame has no resume latency */
+    WRITE_ONCE(priv->resume_ts, 0);
+    imx547_queue_stop(priv);
+
+    if (warm_ms && priv->warm) {
+        /* master stop only, keep the internal regulators up */
+        err = imx547_write_reg(priv, XMSTA, 0x01);
+        if (!err)
+            imx547_budget_wait(priv, IMX547_BUDGET_STOP_SETTLE);
+        WRITE_ONCE(priv->streaming, false);
+        priv->start_pending = false;
+        priv->warm = !err;
+        if (priv->warm)
+            mod_delayed_work(system_wq, &priv->standby_work,
+                     msecs_to_jiffies(warm_ms));
+    } else {
+        err = imx547_enter_standby(priv);
+    }
+
+    priv->stop_latency_us = ktime_us_delta(ktime_get(), stop_ts);
+    dev_dbg(&priv->client->dev, "%s: stream stop took %u us\n",
+        __func__, priv->stop_latency_us);
+    return err;
+}
+
+/*
+ * imx547_standby_work - Drop a warm sensor to full standby
+ * @work: Pointer to work structure
+ *
+ * Runs once the warm standby time has elapsed without a new stream start.
+ */
+static void imx547_standby_work(struct work_struct *work)
+{
+    struct stimx547 *priv = container_of(to_delayed_work(work),
+                         struct stimx547, standby_work);
+
+    mutex_lock(&priv->lock);
+    if (priv->warm && !priv->streaming && !priv->start_pending) {
+        imx547_enter_standby(priv);
+        dev_dbg(&priv->client->dev, "%s: warm standby expired\n", __func__);
+    }
+    mutex_unlock(&priv->lock);
+}
+
+
+/*
+ * imx547_set_cluster - Apply the exposure, gain, black level and VBLANK cluster
+ * @priv: Pointer to device structure
+ *
+ * Only the controls changed by the request are written, all under one
+ * REGHOLD so that a VIDIOC_S_EXT_CTRLS batch lands on one frame. SHS
+ * counts back from the end of the frame, so it is rewritten with VMAX.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_set_cluster(struct stimx547 *priv)
+{
+    struct imx547_ctrls *ctrls = &priv->ctrls;
+    int err, ret;
+
+    /* VBLANK only mirrors a frame length the driver already programmed */
+    if (priv->blanking_sync)
+        return 0;
+
+    err = imx547_group_hold(priv);
+    if (err)
+        return err;
+
+    if (ctrls->vblank->is_new)
+        err = imx547_set_vblank(priv, ctrls->vblank->val);
+
+    if (!err && ctrls->gain->is_new)
+        err = imx547_set_gain(priv, ctrls->gain->val);
+
+    if (!err && ctrls->black_level->is_new)
+        err = imx547_set_black_level(priv, ctrls->black_level->val);
+
+    if (!err && (ctrls->exposure->is_new || ctrls->vblank->is_new))
+        err = imx547_set_exposure(priv, ctrls->exposure->val);
+
+    ret = imx547_group_release(priv);
+
+    return err ? err : ret;
+}
+
+/*
+ * imx547_set_trigger_mode - Select free run or external trigger
+ * @priv: Pointer to device structure
+ * @val: Trigger mode (IMX547_TRIGGER_*)
+ *
+ * In the trigger modes VMAX gives the shortest trigger period. The
+ * exposure control has no effect with pulse width exposure.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_set_trigger_mode(struct stimx547 *priv, int val)
+{
+    int err;
+
+    err = imx547_update_mbreg(priv, IMX547_DIRTY_CTRLS, TRIGMODE, val, 1);
+    if (err) {
+        dev_err(&priv->client->dev, "%s: TRIGMODE control error\n", __func__);
+        return err;
+    }
+
+    v4l2_ctrl_activate(priv->ctrls.exposure,
+               val != IMX547_TRIGGER_PULSE_WIDTH);
+    v4l2_ctrl_activate(priv->ctrls.trigger_delay,
+               val != IMX547_TRIGGER_FREE_RUN);
+
+    return 0;
+}
+
+/*
+ * imx547_mode_supports - Check a media bus code against a mode
+ * @mode: Sensor mode
+ * @code: Media bus code
+ *
+ * Return: true if the mode can output @code
+ */
+static bool imx547_mode_supports(const struct imx547_mode *mode, u32 code)
+{
+    const struct imx547_format *fmt;
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(imx547_formats); i++) {
+        fmt = &imx547_formats[i];
+        if (fmt->code == code)
+            return fmt->bit_depth == mode->bit_depth;
+    }
+
+    return false;
+}
+
+/*
+ * imx547_exposure_lines - Integration lines closest to an exposure time
+ * @priv: Pointer to device structure
+ * @frame_length: Frame length in lines
+ * @us: Exposure time in microseconds
+ *
+ * Return: Number of lines, limited to what SHS allows within the frame
+ */
+static u32 imx547_exposure_lines(struct stimx547 *priv, u64 frame_length,
+                 u32 us)
+{
+    u32 lines = imx547_timing_lines(priv->hmax, us);
+
+    return clamp_t(u64, lines, 1, frame_length - priv->mode->min_shs);
+}
+
+/*
+ * imx547_min_hmax - Shortest legal line length of a mode
+ * @priv: Pointer to device structure
+ * @mode: Sensor mode
+ * @width: Output line width
+ *
+ * The line has to fit both the AD conversion of the mode and the output
+ * link, a narrow crop only helps while the link is the limit.
+ *
+ * Return: HMAX in INCK cycles
+ */
+static u32 imx547_min_hmax(const struct stimx547 *priv,
+               const struct imx547_mode *mode, u32 width)
+{
+    u32 link_hmax = imx547_timing_link_hmax(width, mode->bit_depth,
+                        priv->lanes, IMX547_LINK_FREQ);
+
+    return max(mode->hmax, link_hmax);
+}
+
+/*
+ * imx547_min_interval - Shortest frame interval of a mode
+ * @mode: Sensor mode
+ * @crop_height: Height of the readout window
+ * @hmax: Line length in INCK cycles
+ * @fi: Filled with the minimum frame interval
+ *
+ * Fewer lines read out allow a shorter frame.
+ *
+ * Return: Minimum frame length in lines
+ */
+static u32 imx547_min_interval(const struct imx547_mode *mode, u32 crop_height,
+                   u32 hmax, struct v4l2_fract *fi)
+{
+    u32 min_frame_length;
+
+    min_frame_length = mode->vmax - (IMX547_DEFAULT_HEIGHT - crop_height);
+    imx547_timing_interval(hmax, min_frame_length, fi);
+
+    return min_frame_length;
+}
+
+/*
+ * imx547_find_mode - Find the mode for a media bus format
+ * @priv: Pointer to device structure
+ * @fmt: Requested format
+ *
+ * There is one full readout mode per bit depth, the frame size follows
+ * the crop rectangle.
+ *
+ * Return: Pointer to the mode, NULL for an unsupported code
+ */
+static const struct imx547_mode *imx547_find_mode(struct stimx547 *priv,
+                          const struct v4l2_mbus_framefmt *fmt)
+{
+    unsigned int i;
+
+    for (i = 0; i < IMX547_MODE_NUM; i++) {
+        if (imx547_mode_supports(&priv->modes[i], fmt->code))
+            return &priv->modes[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * imx547_g_volatile_ctrl - Read the imx547 volatile V4L2 controls
+ * @ctrl: V4L2 control to be read
+ *
+ * The trigger delay is the time from the trigger, the trigger end with
+ * pulse width exposure, until readout starts. Its fixed part is the
+ * latency measured on the board.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+    struct v4l2_subdev *sd = ctrl_to_sd(ctrl);
+    struct stimx547 *imx547 = to_imx547(sd);
+    u32 latency;
+
+    switch (ctrl->id) {
+    case IMX547_CID_TRIGGER_DELAY:
+        latency = imx547->trigger_latency_us;
+
+        switch (imx547->ctrls.trigger_mode->cur.val) {
+        case IMX547_TRIGGER_EDGE:
+            ctrl->val = latency + imx547->ctrls.exposure->cur.val;
+            break;
+        case IMX547_TRIGGER_PULSE_WIDTH:
+            ctrl->val = latency;
+            break;
+        default:
+            ctrl->val = 0;
+            break;
+        }
+        return 0;
+    }
+
+    return -EINVAL;
+}
+
+/**
+ * imx547_try_ctrl - Validate imx547 V4L2 control values
+ * @ctrl: V4L2 control to be checked
+ *
+ * Runs for VIDIOC_TRY_EXT_CTRLS as well as before s_ctrl, so invalid
+ * values are reported without touching the sensor. The exposure is
+ * rounded to the value the sensor achieves, which then becomes the
+ * control value.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_try_ctrl(struct v4l2_ctrl *ctrl)
+{
+    struct v4l2_subdev *sd = ctrl_to_sd(ctrl);
+    struct stimx547 *imx547 = to_imx547(sd);
+    struct v4l2_ctrl *vblank = imx547->ctrls.vblank;
+    u64 frame_length;
+    u32 lines;
+
+    switch (ctrl->id) {
+    case V4L2_CID_EXPOSURE:
+        /* the frame the cluster is about to set, VBLANK included */
+        frame_length = imx547->frame_length;
+        if (vblank->is_new)
+            frame_length = imx547->format.height + vblank->val;
+
+        /* whole lines within the frame, what the sensor will run with */
+        lines = imx547_exposure_lines(imx547, frame_length, ctrl->val);
+        ctrl->val = imx547_timing_us(imx547->hmax, lines);
+        return 0;
+
+    case IMX547_CID_FRAME_QUEUE:
+        return imx547_try_queue(imx547, ctrl);
+    }
+
+    return 0;
+}
+
+/*
+ * imx547_table_reg - Look up a register in a register table
+ * @table: Table of register runs
+ * @addr: Register address
+ * @val: Filled with the value written to @addr
+ *
+ * Return: true if @table writes @addr
+ */
+static bool imx547_table_reg(const struct imx547_reg_table *table, u16 addr,
+                 u8 *val)
+{
+    const struct imx547_reg_run *run;
+    unsigned int i;
+
+    /* the last write wins */
+    for (i = table->num_runs; i-- > 0; ) {
+        run = &table->runs[i];
+        if (addr >= run->addr && addr < run->addr + run->len) {
+            *val = run->vals[addr - run->addr];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * imx547_table_setting - Value the register tables leave in a register
+ * @priv: Pointer to device structure
+ * @addr: Register address
+ *
+ * The mode table is written after the common settings, both may come
+ * from the mode pack.
+ *
+ * Return: register value, 0 if no table writes @addr
+ */
+static u8 imx547_table_setting(const struct stimx547 *priv, u16 addr)
+{
+    u8 val = 0;
+
+    if (!imx547_table_reg(priv->mode->regs, addr, &val))
+        imx547_table_reg(priv->common, addr, &val);
+
+    return val;
+}
+
+/*
+ * imx547_queue_delay - Frames from applying a queue tuple to its image
+ * @priv: Pointer to device structure
+ * @min_frame_length: Shortest frame length of the mode and crop in lines
+ *
+ * GAINDLY holds the gain back by whole frames. GSDLY moves the transfer
+ * to the analog memory by lines, which only reaches into a later frame
+ * when frames are shorter than it. Shortest frames give the longest
+ * delay, so the result holds for any VBLANK.
+ *
+ * Return: delay in frames
+ */
+static u32 imx547_queue_delay(const struct stimx547 *priv,
+                  u32 min_frame_length)
+{
+    u32 delay = imx547_table_setting(priv, GAINDLY) +
+            imx547_table_setting(priv, GSDLY) / min_frame_length;
+
+    return max_t(u32, delay, IMX547_QUEUE_MIN_DELAY);
+}
+
+/*
+ * imx547_update_blanking - Update the blanking controls to the timing
+ * @priv: Pointer to device structure
+ *
+ * HBLANK follows HMAX of the mode and the output width, VBLANK range and
+ * value follow the frame length. The queue delay follows the mode tables
+ * and the shortest frame. Needs to run after the frame length, the mode
+ * or the crop changes.
+ * The caller should hold the mutex lock imx547->lock.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_update_blanking(struct stimx547 *priv)
+{
+    struct imx547_ctrls *ctrls = &priv->ctrls;
+    struct v4l2_fract fi, slowest = { 1, IMX547_MIN_FRAME_RATE };
+    u32 height = priv->format.height;
+    u32 min_fl, max_fl, hblank, vblank, delay;
+    int err;
+
+    hblank = priv->hmax * IMX547_PIXELS_PER_INCK - priv->format.width;
+    err = __v4l2_ctrl_modify_range(ctrls->hblank, hblank, hblank, 1, hblank);
+    if (err)
+        goto fail;
+
+    min_fl = imx547_min_interval(priv->mode, priv->crop.height, priv->hmax,
+                     &fi);
+    max_fl = imx547_timing_vmax(priv->hmax, &slowest);
+    vblank = priv->frame_length - height;
+
+    /* the range update may clamp the value, keep VMAX out of it */
+    priv->blanking_sync = true;
+    err = __v4l2_ctrl_modify_range(ctrls->vblank, min_fl - height,
+                       max_fl - height, 1, vblank);
+    if (!err)
+        err = __v4l2_ctrl_s_ctrl(ctrls->vblank, vblank);
+    priv->blanking_sync = false;
+    if (err)
+        goto fail;
+
+    if (ctrls->queue_delay) {
+        delay = imx547_queue_delay(priv, min_fl);
+        err = __v4l2_ctrl_modify_range(ctrls->queue_delay, delay, delay, 1,
+                           delay);
+        if (err)
+            goto fail;
+    }
+
+    return 0;
+
+fail:
+    dev_err(&priv->client->dev, "%s: blanking ctrl update failed\n", __func__);
+    return err;
+}
+
+/*
+ * imx547_set_vblank - Set the frame length from the vertical blanking
+ * @priv: Pointer to device structure
+ * @val: Vertical blanking in lines
+ *
+ * The frame interval follows the new frame length. Called from the
+ * exposure cluster, which rewrites SHS for the new frame length.
+ * The caller should hold the mutex lock imx547->lock.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_set_vblank(struct stimx547 *priv, int val)
+{
+    u64 frame_length = priv->format.height + val;
+
+    if (frame_length == priv->frame_length)
+        return 0;
+
+    priv->frame_length = frame_length;
+    priv->frame_ns = imx547_timing_ns(priv->hmax, frame_length);
+    imx547_timing_interval(priv->hmax, frame_length, &priv->frame_interval);
+
+    return imx547_set_frame_length(priv);
+}
+
+/**
+ * imx547_s_ctrl - This is used to set the imx547 V4L2 controls
+ * @ctrl: V4L2 control to be set
+ *
+ * This function is used to set the V4L2 controls for the imx547 sensor.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+    struct v4l2_subdev *sd = ctrl_to_sd(ctrl);
+    struct stimx547 *imx547 = to_imx547(sd);
+    int ret = -EINVAL;
+
+    dev_dbg(&imx547->client->dev,
+        "%s : s_ctrl: %s, value: %d\n", __func__,
+        ctrl->name, ctrl->val);
+
+    /* read-only controls follow the driver state, there is nothing to write */
+    if (ctrl->flags & V4L2_CTRL_FLAG_READ_ONLY)
+        return 0;
+
+    switch (ctrl->id) {
+    case V4L2_CID_EXPOSURE:
+        /* cluster master, gain, black level and VBLANK arrive here too */
+        dev_dbg(&imx547->client->dev,
+            "%s : set exposure/gain/black level cluster\n", __func__);
+        ret = imx547_set_cluster(imx547);
+        break;
+
+    case V4L2_CID_TEST_PATTERN:
+        dev_dbg(&imx547->client->dev,
+            "%s : set V4L2_CID_TEST_PATTERN\n", __func__);
+        ret = imx547_set_test_pattern(imx547, ctrl->val);
+        break;
+
+    case IMX547_CID_TRIGGER_MODE:
+        dev_dbg(&imx547->client->dev,
+            "%s : set trigger mode\n", __func__);
+        ret = imx547_set_trigger_mode(imx547, ctrl->val);
+        break;
+
+    case IMX547_CID_FRAME_QUEUE:
+        dev_dbg(&imx547->client->dev,
+            "%s : set frame queue, %u values\n", __func__,
+            ctrl->new_elems);
+        ret = imx547_set_queue(imx547, ctrl);
+        break;
+
+    }
+
+    return ret;
+}
+
+
+/*
+ * imx547_finfo_format - Format of the frame information pad
+ * @mode: Sensor mode
+ * @image: Image pad format
+ * @fmt: Filled with the frame information format
+ *
+ * The frame information lines have the line width and bit depth of the
+ * image.
+ */
+static void imx547_finfo_format(const struct imx547_mode *mode,
+                const struct v4l2_mbus_framefmt *image,
+                struct v4l2_mbus_framefmt *fmt)
+{
+    memset(fmt, 0, sizeof(*fmt));
+    fmt->width = image->width;
+    fmt->height = IMX547_FINFO_LINES;
+    fmt->code = mode->meta_code;
+    fmt->field = V4L2_FIELD_NONE;
+}
+
+/**
+ * imx547_enum_mbus_code - Enumerate the media bus codes
+ * @sd: Pointer to V4L2 Sub device structure
+ * @sd_state: Pointer to V4L2 Sub device state information structure
+ * @code: Pointer to V4L2 Sub device code enumeration structure
+ *
+ * Return: 0 on success, -EINVAL past the last code
+ */
+static int imx547_enum_mbus_code(struct v4l2_subdev *sd,
+                 struct v4l2_subdev_state *sd_state,
+                 struct v4l2_subdev_mbus_code_enum *code)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+
+    if (code->pad == IMX547_PAD_FINFO) {
+        if (code->index >= IMX547_MODE_NUM)
+            return -EINVAL;
+
+        code->code = imx547->modes[code->index].meta_code;
+        return 0;
+    }
+
+    if (code->index >= ARRAY_SIZE(imx547_formats))
+        return -EINVAL;
+
+    code->code = imx547_formats[code->index].code;
+
+    return 0;
+}
+
+/**
+ * imx547_enum_frame_size - Enumerate the frame sizes of a media bus code
+ * @sd: Pointer to V4L2 Sub device structure
+ * @sd_state: Pointer to V4L2 Sub device state information structure
+ * @fse: Pointer to V4L2 Sub device frame size enumeration structure
+ *
+ * One entry per mode supporting the code, covering all crop rectangles.
+ * The frame information lines are as wide as the image.
+ *
+ * Return: 0 on success, -EINVAL past the last mode
+ */
+static int imx547_enum_frame_size(struct v4l2_subdev *sd,
+                  struct v4l2_subdev_state *sd_state,
+                  struct v4l2_subdev_frame_size_enum *fse)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+    const struct imx547_mode *mode;
+    unsigned int i, index = 0;
+
+    for (i = 0; i < IMX547_MODE_NUM; i++) {
+        mode = &imx547->modes[i];
+
+        if (fse->pad == IMX547_PAD_FINFO) {
+            if (mode->meta_code != fse->code || fse->index)
+                continue;
+
+            fse->min_width = IMX547_MIN_CROP_WIDTH;
+            fse->max_width = IMX547_DEFAULT_WIDTH;
+            fse->min_height = IMX547_FINFO_LINES;
+            fse->max_height = IMX547_FINFO_LINES;
+            return 0;
+        }
+
+        if (!imx547_mode_supports(mode, fse->code))
+            continue;
+
+        if (index++ != fse->index)
+            continue;
+
+        fse->min_width = IMX547_MIN_CROP_WIDTH;
+        fse->max_width = IMX547_DEFAULT_WIDTH;
+        fse->min_height = IMX547_MIN_CROP_HEIGHT;
+        fse->max_height = IMX547_DEFAULT_HEIGHT;
+        return 0;
+    }
+
+    return -EINVAL;
+}
+
+/**
+ * imx547_enum_frame_interval - Enumerate the frame intervals of a format
+ * @sd: Pointer to V4L2 Sub device structure
+ * @sd_state: Pointer to V4L2 Sub device state information structure
+ * @fie: Pointer to V4L2 Sub device frame interval enumeration structure
+ *
+ * Uses the mode set_fmt would select. The first entry is the shortest
+ * interval for the frame height, followed by the standard rates below it.
+ * Any interval in between can be set.
+ *
+ * Return: 0 on success, -EINVAL past the last interval
+ */
+static int imx547_enum_frame_interval(struct v4l2_subdev *sd,
+                      struct v4l2_subdev_state *sd_state,
+                      struct v4l2_subdev_frame_interval_enum *fie)
+{
+    static const u32 rates[] = { 120, 60, 30, 15, 10, 5, IMX547_MIN_FRAME_RATE };
+    struct stimx547 *imx547 = to_imx547(sd);
+    struct v4l2_mbus_framefmt fmt = {
+        .width = fie->width,
+        .height = fie->height,
+        .code = fie->code,
+    };
+    const struct imx547_mode *mode;
+    struct v4l2_fract max_fi;
+    unsigned int i, index = 0;
+    int err = -EINVAL;
+
+    mutex_lock(&imx547->lock);
+
+    mode = imx547_find_mode(imx547, &fmt);
+    if (!mode)
+        goto unlock;
+
+    if (fie->width < IMX547_MIN_CROP_WIDTH ||
+        fie->width > IMX547_DEFAULT_WIDTH ||
+        fie->height < IMX547_MIN_CROP_HEIGHT ||
+        fie->height > IMX547_DEFAULT_HEIGHT)
+        goto unlock;
+
+    imx547_min_interval(mode, fie->height,
+                imx547_min_hmax(imx547, mode, fie->width), &max_fi);
+
+    if (fie->index == 0) {
+        fie->interval = max_fi;
+        err = 0;
+        goto unlock;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(rates); i++) {
+        /* rates[i] < denominator / numerator */
+        if ((u64)rates[i] * max_fi.numerator >= max_fi.denominator)
+            continue;
+
+        if (++index == fie->index) {
+            fie->interval.numerator = 1;
+            fie->interval.denominator = rates[i];
+            err = 0;
+            break;
+        }
+    }
+
+unlock:
+    mutex_unlock(&imx547->lock);
+
+    return err;
+}
+
+/**
+ * imx547_init_state - Initialize a TRY state
+ * @sd: Pointer to V4L2 Sub device structure
+ * @sd_state: Pointer to V4L2 Sub device state information structure
+ *
+ * TRY formats and crops start from the active configuration.
+ *
+ * Return: 0 on success
+ */
+static int imx547_init_state(struct v4l2_subdev *sd,
+                 struct v4l2_subdev_state *sd_state)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+
+    mutex_lock(&imx547->lock);
+    *v4l2_subdev_state_get_format(sd_state, IMX547_PAD_IMAGE) = imx547->format;
+    *v4l2_subdev_state_get_crop(sd_state, IMX547_PAD_IMAGE) = imx547->crop;
+    imx547_finfo_format(imx547->mode, &imx547->format,
+                v4l2_subdev_state_get_format(sd_state, IMX547_PAD_FINFO));
+    mutex_unlock(&imx547->lock);
+
+    return 0;
+}
+
+/**
+ * imx547_get_fmt - Get the pad format
+ * @sd: Pointer to V4L2 Sub device structure
+ * @cfg: Pointer to sub device pad information structure
+ * @fmt: Pointer to pad level media bus format
+ *
+ * This function is used to get the pad format information. The frame
+ * information format follows the image format of the same @fmt->which.
+ *
+ * Return: 0 on success
+ */
+static int imx547_get_fmt(struct v4l2_subdev *sd,
+              struct v4l2_subdev_state *sd_state,
               struct v4l2_subdev_format *fmt)
 {
     struct stimx547 *imx547 = to_imx547(sd);
+    struct v4l2_mbus_framefmt image;
+
+    mutex_lock(&imx547->lock);
+
+    if (fmt->which == V4L2_SUBDEV_FORMAT_TRY)
+        image = *v4l2_subdev_state_get_format(sd_state, IMX547_PAD_IMAGE);
+    else
+        image = imx547->format;
+
+    if (fmt->pad == IMX547_PAD_FINFO)
+        imx547_finfo_format(imx547_find_mode(imx547, &image), &image,
+                    &fmt->format);
+    else
+        fmt->format = image;
+
+    mutex_unlock(&imx547->lock);
+    return 0;
+}
+
+/**
+ * imx547_set_fmt - This is used to set the pad format
+ * @sd: Pointer to V4L2 Sub device structure
+ * @cfg: Pointer to sub device pad information structure
+ * @format: Pointer to pad level media bus format
+ *
+ * This function is used to set the pad format.
+ *
+ * Return: 0 on success
+ */
+static int imx547_set_fmt(struct v4l2_subdev *sd,
+              struct v4l2_subdev_state *sd_state,
+              struct v4l2_subdev_format *format)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+    struct v4l2_mbus_framefmt *fmt = &format->format;
+    const struct imx547_mode *mode;
+    const struct v4l2_rect *crop;
+    int err = 0;
+
+    /* the frame information format is fixed by the image format */
+    if (format->pad == IMX547_PAD_FINFO)
+        return imx547_get_fmt(sd, sd_state, format);
+
+    mutex_lock(&imx547->lock);
+
+    mode = imx547_find_mode(imx547, fmt);
+    if (!mode) {
+        dev_err(&imx547->client->dev, "%s: Cannot find mode\n", __func__);
+        err = -EINVAL;
+        goto unlock;
+    }
+
+    /* frame size is set by the crop rectangle */
+    if (format->which == V4L2_SUBDEV_FORMAT_TRY)
+        crop = v4l2_subdev_state_get_crop(sd_state, format->pad);
+    else
+        crop = &imx547->crop;
+
+    fmt->width = crop->width;
+    fmt->height = crop->height;
+
+    if (format->which == V4L2_SUBDEV_FORMAT_TRY) {
+        *v4l2_subdev_state_get_format(sd_state, format->pad) = *fmt;
+        goto unlock;
+    }
+
+    if (mode != imx547->mode &&
+        (imx547->streaming || imx547->start_pending)) {
+        err = -EBUSY;
+        goto unlock;
+    }
+
+    imx547->format = *fmt;
+    imx547->hmax = imx547_min_hmax(imx547, mode, fmt->width);
+
+    if (mode != imx547->mode) {
+        imx547->mode = mode;
+        dev_dbg(&imx547->client->dev, "%s: mode %s\n", __func__, mode->name);
+
+        /* frame rate limit and control ranges depend on the mode */
+        err = imx547_set_frame_interval(imx547);
+        if (!err)
+            err = imx547_update_exposure_range(imx547);
+        if (!err)
+            err = imx547_sync_exposure(imx547);
+        if (!err)
+            err = __v4l2_ctrl_modify_range(imx547->ctrls.black_level,
+                               IMX547_MIN_BLACK_LEVEL,
+                               mode->max_black_level, 1,
+                               mode->def_black_level);
+    }
+
+unlock:
+    mutex_unlock(&imx547->lock);
+
+    return err;
+}
+
+
+/**
+ * imx547_get_frame_desc - Describe the data sent from a source pad
+ * @sd: Pointer to V4L2 Sub device structure
+ * @pad: Source pad
+ * @fd: Pointer to media bus frame descriptor
+ *
+ * One entry per pad. The frame information lines carry the exposure,
+ * gain and frame count the frame was captured with. They share the bit
+ * depth and line width of the image, so a receiver can split them off
+ * by line count. Lengths are the bytes of one frame.
+ *
+ * Return: 0 on success, -EINVAL for an unknown pad
+ */
+static int imx547_get_frame_desc(struct v4l2_subdev *sd, unsigned int pad,
+                 struct v4l2_mbus_frame_desc *fd)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+    struct v4l2_mbus_frame_desc_entry *entry = fd->entry;
+    u32 bpp, width, lines;
+
+    if (pad >= IMX547_NUM_PADS)
+        return -EINVAL;
+
+    mutex_lock(&imx547->lock);
+
+    bpp = imx547->mode->bit_depth;
+    width = imx547->format.width;
+
+    memset(fd, 0, sizeof(*fd));
+    fd->type = V4L2_MBUS_FRAME_DESC_TYPE_PARALLEL;
+    fd->num_entries = 1;
+
+    entry->flags = V4L2_MBUS_FRAME_DESC_FL_LEN_MAX;
+    if (pad == IMX547_PAD_FINFO) {
+        entry->pixelcode = imx547->mode->meta_code;
+        lines = IMX547_FINFO_LINES;
+    } else {
+        entry->pixelcode = imx547->format.code;
+        lines = imx547->format.height;
+    }
+    entry->length = width * lines * bpp / 8;
+
+    mutex_unlock(&imx547->lock);
+
+    return 0;
+}
+
+/**
+ * imx547_get_mbus_config - Report the output link configuration
+ * @sd: Pointer to V4L2 Sub device structure
+ * @pad: Source pad
+ * @cfg: Pointer to media bus configuration
+ *
+ * Both pads share the link. V4L2 has no SLVS-EC bus type, the lanes are
+ * reported in the CSI-2 lane fields of an unknown bus. The lane rate is
+ * read from the V4L2_CID_LINK_FREQ control, the link_freq field is too
+ * new for 6.8.
+ *
+ * Return: 0 on success, -EINVAL for an unknown pad
+ */
+static int imx547_get_mbus_config(struct v4l2_subdev *sd, unsigned int pad,
+                  struct v4l2_mbus_config *cfg)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+    unsigned int i;
+
+    if (pad >= IMX547_NUM_PADS)
+        return -EINVAL;
+
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->type = V4L2_MBUS_UNKNOWN;
+    cfg->bus.mipi_csi2.num_data_lanes = imx547->lanes;
+    for (i = 0; i < imx547->lanes; i++)
+        cfg->bus.mipi_csi2.data_lanes[i] = i + 1;
+
+    return 0;
+}
+
+/**
+ * imx547_get_selection - Get the crop rectangle and its bounds
+ * @sd: Pointer to V4L2 Sub device structure
+ * @sd_state: Pointer to V4L2 Sub device state information structure
+ * @sel: Pointer to V4L2 Sub device selection structure
+ *
+ * The TRY crop rectangle is kept in @sd_state, the active one in the
+ * device structure.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_get_selection(struct v4l2_subdev *sd,
+                struct v4l2_subdev_state *sd_state,
+                struct v4l2_subdev_selection *sel)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+
+    if (sel->pad != IMX547_PAD_IMAGE)
+        return -EINVAL;
+
+    switch (sel->target) {
+    case V4L2_SEL_TGT_CROP:
+        if (sel->which == V4L2_SUBDEV_FORMAT_TRY) {
+            sel->r = *v4l2_subdev_state_get_crop(sd_state, sel->pad);
+            return 0;
+        }
+
+        mutex_lock(&imx547->lock);
+        sel->r = imx547->crop;
+        mutex_unlock(&imx547->lock);
+        return 0;
+
+    case V4L2_SEL_TGT_CROP_DEFAULT:
+    case V4L2_SEL_TGT_CROP_BOUNDS:
+    case V4L2_SEL_TGT_NATIVE_SIZE:
+        sel->r.left = 0;
+        sel->r.top = 0;
+        sel->r.width = IMX547_DEFAULT_WIDTH;
+        sel->r.height = IMX547_DEFAULT_HEIGHT;
+        return 0;
+    }
+
+    return -EINVAL;
+}
+
+/**
+ * imx547_set_selection - Set the hardware readout window
+ * @sd: Pointer to V4L2 Sub device structure
+ * @sd_state: Pointer to V4L2 Sub device state information structure
+ * @sel: Pointer to V4L2 Sub device selection structure
+ *
+ * The rectangle is aligned and clamped to the pixel array. The format
+ * size follows the crop, the maximum frame rate and the exposure range
+ * are recomputed from the cropped height.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_set_selection(struct v4l2_subdev *sd,
+                struct v4l2_subdev_state *sd_state,
+                struct v4l2_subdev_selection *sel)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+    struct v4l2_mbus_framefmt *try_fmt;
+    struct v4l2_rect r;
+    int err = 0;
+
+    if (sel->pad != IMX547_PAD_IMAGE || sel->target != V4L2_SEL_TGT_CROP)
+        return -EINVAL;
+
+    r.width = clamp_t(u32, ALIGN(sel->r.width, IMX547_CROP_ALIGN),
+              IMX547_MIN_CROP_WIDTH, IMX547_DEFAULT_WIDTH);
+    r.height = clamp_t(u32, ALIGN(sel->r.height, IMX547_CROP_ALIGN),
+               IMX547_MIN_CROP_HEIGHT, IMX547_DEFAULT_HEIGHT);
+    r.left = clamp_t(s32, ALIGN_DOWN(sel->r.left, IMX547_CROP_ALIGN), 0,
+             IMX547_DEFAULT_WIDTH - r.width);
+    r.top = clamp_t(s32, ALIGN_DOWN(sel->r.top, IMX547_CROP_ALIGN), 0,
+            IMX547_DEFAULT_HEIGHT - r.height);
+    sel->r = r;
+
+    if (sel->which == V4L2_SUBDEV_FORMAT_TRY) {
+        *v4l2_subdev_state_get_crop(sd_state, sel->pad) = r;
+
+        /* the TRY format size follows the TRY crop */
+        try_fmt = v4l2_subdev_state_get_format(sd_state, sel->pad);
+        try_fmt->width = r.width;
+        try_fmt->height = r.height;
+        return 0;
+    }
+
+    mutex_lock(&imx547->lock);
+
+    if (imx547->streaming || imx547->start_pending) {
+        err = -EBUSY;
+        goto unlock;
+    }
+
+    imx547->crop = r;
+    imx547->format.width = r.width;
+    imx547->format.height = r.height;
+    imx547->hmax = imx547_min_hmax(imx547, imx547->mode,
+                       imx547->format.width);
+
+    err = imx547_set_frame_interval(imx547);
+    if (!err)
+        err = imx547_update_exposure_range(imx547);
+    if (!err)
+        err = imx547_sync_exposure(imx547);
+
+unlock:
+    mutex_unlock(&imx547->lock);
+
+    return err;
+}
+
+/**
+ * imx547_g_frame_interval - Get the frame interval
+ * @sd: Pointer to V4L2 Sub device structure
+ * @sd_state: Pointer to V4L2 Sub device state information structure
+ * @fi: Pointer to V4l2 Sub device frame interval structure
+ *
+ * This function is used to get the frame interval.
+ *
+ * Return: 0 on success
+ */
+static int imx547_g_frame_interval(struct v4l2_subdev *sd,
+                   struct v4l2_subdev_state *sd_state,
+                   struct v4l2_subdev_frame_interval *fi)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+
+    fi->interval = imx547->frame_interval;
+    dev_dbg(&imx547->client->dev, "%s frame rate = %d / %d\n", __func__, imx547->frame_interval.numerator, imx547->frame_interval.denominator);
+
+    return 0;
+}
+
+/*
+ * imx547_update_exposure_range - Update the exposure control range
+ * @priv: Pointer to device structure
+ *
+ * The range covers the longest frame of the line length, so it does not
+ * change with VBLANK inside the exposure cluster. An exposure longer
+ * than the current frame is shortened to it by imx547_try_ctrl(). The
+ * range needs to be updated after the mode or the crop width changes.
+ * The caller should hold the mutex lock imx547->lock.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_update_exposure_range(struct stimx547 *priv)
+{
+    struct v4l2_fract slowest = { 1, IMX547_MIN_FRAME_RATE };
+    int min, max, def;
+    u32 min_reg_shs, max_frame_length;
+    int err;
+
+    min_reg_shs = priv->mode->min_shs;
+    max_frame_length = imx547_timing_vmax(priv->hmax, &slowest);
+
+    min = IMX547_MIN_EXPOSURE_TIME;
+    max = imx547_timing_us(priv->hmax, max_frame_length - min_reg_shs);
+    def = IMX547_DEF_EXPOSURE_TIME;
+    err = __v4l2_ctrl_modify_range(priv->ctrls.exposure, min, max, 1, def);
+    if (err)
+        dev_err(&priv->client->dev, "Exposure ctrl range update failed\n");
+
+    return err;
+}
+
+/*
+ * imx547_sync_exposure - Follow a frame length change with SHS
+ * @priv: Pointer to device structure
+ *
+ * SHS counts back from the end of the frame, so it is rewritten for the
+ * new frame length. If the exposure no longer fits the frame, the control
+ * is updated to the shorter exposure the sensor now runs with. Not for
+ * use from the exposure cluster's own s_ctrl.
+ * The caller should hold the mutex lock imx547->lock.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_sync_exposure(struct stimx547 *priv)
+{
+    struct v4l2_ctrl *ctrl = priv->ctrls.exposure;
+    u32 lines;
+    int err;
+
+    err = imx547_set_exposure(priv, ctrl->cur.val);
+    if (err)
+        return err;
+
+    lines = imx547_exposure_lines(priv, priv->frame_length, ctrl->cur.val);
+
+    return __v4l2_ctrl_s_ctrl(ctrl, imx547_timing_us(priv->hmax, lines));
+}
+
+/**
+ * imx547_s_frame_interval - Set the frame interval
+ * @sd: Pointer to V4L2 Sub device structure
+ * @sd_state: Pointer to V4L2 Sub device state information structure
+ * @fi: Pointer to V4l2 Sub device frame interval structure
+ *
+ * This function is used to set the frame interval.
+ *
+ * Return: 0 on success
+ */
+static int imx547_s_frame_interval(struct v4l2_subdev *sd,
+                   struct v4l2_subdev_state *sd_state,
+                   struct v4l2_subdev_frame_interval *fi)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+    int ret, err;
+
+    mutex_lock(&imx547->lock);
+
+    /* VMAX and the follow-up SHS update must land on the same frame */
+    ret = imx547_group_hold(imx547);
+    if (ret)
+        goto unlock;
+
+    imx547->frame_interval = fi->interval;
+    ret = imx547_set_frame_interval(imx547);
+    if (!ret) {
+        /* report the achieved interval, update exposure time accordingly */
+        fi->interval = imx547->frame_interval;
+        ret = imx547_sync_exposure(imx547);
+
+        dev_dbg(&imx547->client->dev, "set frame interval to %llu us\n", fi->interval.numerator * IMX547_M_FACTOR / fi->interval.denominator);
+    }
+
+    err = imx547_group_release(imx547);
+    if (!ret)
+        ret = err;
+unlock:
+    mutex_unlock(&imx547->lock);
+
+    return ret;
+}
+
+/*
+ * imx547_stream_on - Program the sensor and start streaming
+ * @priv: Pointer to device structure
+ * @async: Return before the sensor is streaming
+ *
+ * Only the register blocks that are dirty or differ from the regmap
+ * cache are written.
+ * The caller should hold the mutex lock imx547->lock.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_stream_on(struct stimx547 *priv, bool async)
+{
+    int ret;
+
+    priv->start_ts = ktime_get();
+
+    /* load common registers */
+    ret = imx547_common_regs(priv);
+    if (ret)
+        return ret;
+
+    /* load pixel format registers */
+    ret = imx547_set_pixel_format(priv);
+    if (ret)
+        return ret;
+
+    /* program readout window */
+    ret = imx547_set_window(priv);
+    if (ret)
+        return ret;
+
+    /* program line time */
+    ret = imx547_set_hmax(priv);
+    if (ret)
+        return ret;
+
+    /* update frame interval */
+    ret = imx547_set_frame_interval(priv);
+    if (ret)
+        return ret;
+
+    /* update exposure time, with all controls if the sensor lost them */
+    if (priv->dirty & IMX547_DIRTY_CTRLS)
+        ret = __v4l2_ctrl_handler_setup(&priv->ctrls.handler);
+    else
+        ret = imx547_set_exposure(priv, priv->ctrls.exposure->cur.val);
+    if (ret)
+        return ret;
+
+    /* register cache mirrors the sensor from here on */
+    priv->dirty = 0;
+
+    /* start stream */
+    if (async)
+        return imx547_start_stream_async(priv);
+
+    return imx547_start_stream(priv);
+}
+
+/**
+ * imx547_s_stream - It is used to start/stop the streaming.
+ * @sd: V4L2 Sub device
+ * @on: Flag (True / False)
+ *
+ * This function controls the start or stop of streaming for the
+ * imx547 sensor.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_s_stream(struct v4l2_subdev *sd, int on)
+{
+    struct stimx547 *imx547 = to_imx547(sd);
+    struct device *dev = &imx547->client->dev;
+    bool put = false;
+    int ret = 0;
+
+    /* replace or stop a background start, start_work takes the lock */
+    cancel_delayed_work_sync(&imx547->start_work);
+
+    /* resume outside the lock, runtime resume takes it */
+    if (on && !READ_ONCE(imx547->pm_stream)) {
+        ret = pm_runtime_resume_and_get(dev);
+        if (ret < 0)
+            return ret;
+        put = true;
+    }
+
+    mutex_lock(&imx547->lock);
+
+    if (on) {
+        ret = imx547_stream_on(imx547, async_stream_start);
+        if (ret)
+            goto fail;
+
+        /* trigger mode cannot change under a running sensor */
+        __v4l2_ctrl_grab(imx547->ctrls.trigger_mode, true);
+
+        if (put)
+            imx547->pm_stream = true;
+    } else {
+        /* stop stream, the power reference is dropped even on errors */
+        ret = imx547_stop_stream(imx547);
+        if (ret)
+            imx547_mark_regs_lost(imx547);
+
+        __v4l2_ctrl_grab(imx547->ctrls.trigger_mode, false);
+
+        put = imx547->pm_stream;
+        imx547->pm_stream = false;
+    }
+
+    mutex_unlock(&imx547->lock);
+
+    if (put) {
+        pm_runtime_mark_last_busy(dev);
+        pm_runtime_put_autosuspend(dev);
+    }
+
+    if (ret) {
+        dev_err(&imx547->client->dev, "s_stream failed\n");
+        return ret;
+    }
+
+    dev_dbg(&imx547->client->dev, "%s : Done\n", __func__);
+    return 0;
+
+fail:
+    imx547_mark_regs_lost(imx547);
+    mutex_unlock(&imx547->lock);
+    if (put)
+        pm_runtime_put(dev);
+    dev_err(&imx547->client->dev, "s_stream failed\n");
+    return ret;
+}
+
+/*
+ * imx547_suspend - System suspend
+ * @dev: Pointer to device structure
+ *
+ * Stops a running stream and powers the sensor down. The register cache
+ * is marked dirty since the sensor may lose power during system sleep.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_suspend(struct device *dev)
+{
+    struct v4l2_subdev *sd = i2c_get_clientdata(to_i2c_client(dev));
+    struct stimx547 *imx547 = to_imx547(sd);
+    int err;
+
+    mutex_lock(&imx547->lock);
+    imx547->resume_stream = imx547->streaming || imx547->start_pending;
+    if (imx547->resume_stream)
+        imx547_stop_stream(imx547);
+    mutex_unlock(&imx547->lock);
+
+    cancel_delayed_work_sync(&imx547->start_work);
+    cancel_work_sync(&imx547->queue_work);
+
+    err = pm_runtime_force_suspend(dev);
+    if (err)
+        return err;
+
+    regcache_cache_only(imx547->regmap, true);
+    regcache_mark_dirty(imx547->regmap);
+
+    return 0;
+}
+
+/*
+ * imx547_resume - System resume
+ * @dev: Pointer to device structure
+ *
+ * Replays the register cache as bulk writes of consecutive registers and
+ * restarts a stream stopped by suspend without blocking the resume.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_resume(struct device *dev)
+{
+    struct v4l2_subdev *sd = i2c_get_clientdata(to_i2c_client(dev));
+    struct stimx547 *imx547 = to_imx547(sd);
+    ktime_t resume_ts = ktime_get();
+    int err;
+
+    err = pm_runtime_force_resume(dev);
+    if (err)
+        return err;
+
+    mutex_lock(&imx547->lock);
+    if (imx547->resume_stream) {
+        imx547->resume_stream = false;
+        WRITE_ONCE(imx547->resume_ts, resume_ts);
+
+        err = imx547_stream_on(imx547, true);
+        if (err) {
+            WRITE_ONCE(imx547->resume_ts, 0);
+            imx547_mark_regs_lost(imx547);
+            dev_err(dev, "%s: stream restart failed %d\n", __func__, err);
+        }
+    }
+    mutex_unlock(&imx547->lock);
+
+    return err;
+}
+
+/*
+ * imx547_runtime_suspend - Put the sensor in its lowest power state
+ * @dev: Pointer to device structure
+ *
+ * Enters full standby, holds the sensor in XCLR if the gpio is wired and
+ * the input pipe in reset. Register writes go to the regmap cache until
+ * resume.
+ *
+ * Return: 0
+ */
+static int imx547_runtime_suspend(struct device *dev)
+{
+    struct v4l2_subdev *sd = i2c_get_clientdata(to_i2c_client(dev));
+    struct stimx547 *imx547 = to_imx547(sd);
+
+    /* warm standby ends here */
+    cancel_delayed_work_sync(&imx547->standby_work);
+
+    mutex_lock(&imx547->lock);
+
+    imx547_enter_standby(imx547);
+    regcache_cache_only(imx547->regmap, true);
+
+    if (imx547->xclr_gpio) {
+        gpiod_set_value_cansleep(imx547->xclr_gpio, 1);
+        regcache_mark_dirty(imx547->regmap);
+    }
+
+    gpiod_set_value_cansleep(imx547->pipe_reset_gpio, 1);
+
+    mutex_unlock(&imx547->lock);
+
+    dev_dbg(dev, "%s: suspended\n", __func__);
+
+    return 0;
+}
+
+/*
+ * imx547_runtime_resume - Power the sensor back up
+ * @dev: Pointer to device structure
+ *
+ * Restores the registers from the regmap cache, including writes made
+ * while suspended. The sensor stays in full standby.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_runtime_resume(struct device *dev)
+{
+    struct v4l2_subdev *sd = i2c_get_clientdata(to_i2c_client(dev));
+    struct stimx547 *imx547 = to_imx547(sd);
+    int err;
 
     mutex_lock(&imx547->lock);
-    fmt->format = imx547->format;
+
+    gpiod_set_value_cansleep(imx547->pipe_reset_gpio, 0);
+
+    if (imx547->xclr_gpio) {
+        gpiod_set_value_cansleep(imx547->xclr_gpio, 0);
+        fsleep(IMX547_XCLR_DELAY_US);
+    }
+
+    regcache_cache_only(imx547->regmap, false);
+    err = regcache_sync(imx547->regmap);
+    if (err) {
+        dev_err(dev, "%s: register restore failed %d\n", __func__, err);
+        imx547_mark_regs_lost(imx547);
+    }
+
     mutex_unlock(&imx547->lock);
+
+    dev_dbg(dev, "%s: resumed\n", __func__);
+
+    return err;
+}
+
+
+/*
+ * imx547_set_gain - Function called when setting gain
+ * @priv: Pointer to device structure
+ * @val: Value of gain
+ *
+ * Set the gain based on input value.
+ * The caller should hold the mutex lock imx547->lock if necessary
+ *
+ * Return: 0 on success
+ */
+static int imx547_set_gain(struct stimx547 *priv, int val)
+{
+    
+    int err;
+
+    err = imx547_update_mbreg(priv, IMX547_DIRTY_CTRLS, GAIN_LOW, val, 2);
+    if (err){
+        dev_dbg(&priv->client->dev, "%s: GAIN control error\n", __func__);
+        return err;
+    }
+
+    /* update gain */
+    priv->ctrls.gain->val = val;
+
+    dev_dbg(&priv->client->dev, "%s:  gain val [%d]\n",  __func__, val);
+
+    return 0;
+}
+
+/*
+ * imx547_set_black_level - Function called when setting black level
+ * @priv: Pointer to device structure
+ * @val: Value of black level
+ *
+ * Set the black level based on input value.
+ * The caller should hold the mutex lock imx547->lock if necessary
+ *
+ * Return: 0 on success
+ */
+static int imx547_set_black_level(struct stimx547 *priv, int val)
+{
+    
+    int err;
+
+    err = imx547_update_mbreg(priv, IMX547_DIRTY_CTRLS, BLKLEVEL_LOW, val, 2);
+    if (err){
+        dev_dbg(&priv->client->dev, "%s: BLKLEVEL control error\n", __func__);
+        return err;
+    }
+
+    /* update black level */
+    priv->ctrls.black_level->val = val;
+
+    dev_dbg(&priv->client->dev, "%s:  black level val [%d]\n",  __func__, val);
+
     return 0;
 }
 
-/**
- * imx547_set_fmt - This is used to set the pad format
- * @sd: Pointer to V4L2 Sub device structure
- * @cfg: Pointer to sub device pad information structure
- * @format: Pointer to pad level media bus format
+/*
+ * imx547_set_exposure - Function called when setting exposure time
+ * @priv: Pointer to device structure
+ * @val: Variable for exposure time, in the unit of micro-second
+ *
+ * Set exposure time based on input value. The control itself is left
+ * alone, imx547_try_ctrl() and imx547_sync_exposure() report the value
+ * achieved.
+ * The caller should hold the mutex lock imx547->lock if necessary
+ *
+ * Return: 0 on success
+ */
+static int imx547_set_exposure(struct stimx547 *priv, int val)
+{
+    
+    int err = 0;
+    u32 integration_time_line;
+    u32 reg_shs;
+
+    dev_dbg(&priv->client->dev, "%s: integration time: %d [us]\n", __func__, val);
+
+    /* Check value with internal range */
+    if (val > priv->ctrls.exposure->maximum) {
+        val = priv->ctrls.exposure->maximum;
+    }
+    else if (val < priv->ctrls.exposure->minimum) {
+        val = priv->ctrls.exposure->minimum;
+    }
+
+    integration_time_line = imx547_exposure_lines(priv, priv->frame_length,
+                              val);
+    reg_shs = priv->frame_length - integration_time_line;
+
+    err = imx547_update_mbreg(priv, IMX547_DIRTY_TIMING, SHS_LOW, reg_shs, 3);
+    if (err) {
+        dev_err(&priv->client->dev, "%s: failed to set exposure\n", __func__);
+        return err;
+    }
+
+    val = imx547_timing_us(priv->hmax, integration_time_line);
+
+    dev_dbg(&priv->client->dev,
+     "%s: set integration time: %d [us], coarse1:%d [line], shs: %d [line], frame length: %llu [line]\n",
+     __func__, val, integration_time_line, reg_shs, priv->frame_length);
+
+    return err;
+}
+
+/*
+ * imx547_set_test_pattern - Function called when setting test pattern
+ * @priv: Pointer to device structure
+ * @val: Variable for test pattern
  *
- * This function is used to set the pad format.
+ * Set to different test patterns based on input value.
  *
  * Return: 0 on success
  */
-static int imx547_set_fmt(struct v4l2_subdev *sd,
-              struct v4l2_subdev_state *sd_state,
-              struct v4l2_subdev_format *format)
+static int imx547_set_test_pattern(struct stimx547 *priv, int val)
 {
-    struct stimx547 *imx547 = to_imx547(sd);
-    int err = 0;
 
-    mutex_lock(&imx547->lock);
-    imx547->format = format->format;
+    int err;
 
-    switch (imx547->format.code) {
-        case MEDIA_BUS_FMT_SRGGB10_1X10:
-        case MEDIA_BUS_FMT_Y10_1X10:
-            imx547->line_time = IMX547_DEFAULT_LINE_TIME_10BIT;
-            break;
-        case MEDIA_BUS_FMT_SRGGB12_1X12:
-        case MEDIA_BUS_FMT_Y12_1X12:
-            imx547->line_time = IMX547_DEFAULT_LINE_TIME_12BIT;
-            break;
-        default:
-            dev_err(&imx547->client->dev, "%s: Cannot find line time\n", __func__);
-            return -EINVAL;
+    if (val) {
+        err = imx547_write_reg(priv, 0x3550, 0x07);
+        if (err) 
+            goto fail;
+
+        err = imx547_write_reg(priv, 0x3551, (u8)(val));
+        if (err) 
+            goto fail;
+    }
+    else {
+        err = imx547_write_reg(priv, 0x3550, 0x06);
+        if (err) 
+            goto fail;
     }
 
-    mutex_unlock(&imx547->lock);
+    return 0;
 
+fail:
+    dev_err(&priv->client->dev, "%s: error setting test pattern\n", __func__);
     return err;
 }
 
 
-/**
- * imx547_g_frame_interval - Get the frame interval
- * @sd: Pointer to V4L2 Sub device structure
- * @sd_state: Pointer to V4L2 Sub device state information structure
- * @fi: Pointer to V4l2 Sub device frame interval structure
+/*
+ * imx547_set_window - Function for programming the readout window
+ * @priv: Pointer to device structure
  *
- * This function is used to get the frame interval.
+ * Uses ROI area 1. Each direction is only windowed when it is cropped,
+ * the output line width follows the crop width and the readout mode.
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_set_window(struct stimx547 *priv)
+{
+    const struct v4l2_rect *crop = &priv->crop;
+    u32 roi = 0;
+    int err;
+
+    if (crop->width != IMX547_DEFAULT_WIDTH)
+        roi |= BIT(0);
+    if (crop->height != IMX547_DEFAULT_HEIGHT)
+        roi |= BIT(1);
+
+    err = imx547_update_mbreg(priv, IMX547_DIRTY_MODE, FID0_ROIPH1_LOW,
+                  crop->left, 2);
+    if (!err)
+        err = imx547_update_mbreg(priv, IMX547_DIRTY_MODE, FID0_ROIPV1_LOW,
+                      crop->top, 2);
+    if (!err)
+        err = imx547_update_mbreg(priv, IMX547_DIRTY_MODE, FID0_ROIWH1_LOW,
+                      crop->width, 2);
+    if (!err)
+        err = imx547_update_mbreg(priv, IMX547_DIRTY_MODE, FID0_ROIWV1_LOW,
+                      crop->height, 2);
+    if (!err)
+        err = imx547_update_mbreg(priv, IMX547_DIRTY_MODE, FID0_ROI, roi, 1);
+    if (!err)
+        err = imx547_update_mbreg(priv, IMX547_DIRTY_MODE, VOPB_VBLK_HWID_LOW,
+                      crop->width, 2);
+    if (!err)
+        err = imx547_update_mbreg(priv, IMX547_DIRTY_MODE, FINFO_HWIDTH_LOW,
+                      crop->width, 2);
+    if (err) {
+        dev_err(&priv->client->dev, "%s: unable to set window\n", __func__);
+        return err;
+    }
+
+    dev_dbg(&priv->client->dev, "%s: window %ux%u@(%d,%d)\n", __func__,
+        crop->width, crop->height, crop->left, crop->top);
+
+    return 0;
+}
+
+/*
+ * imx547_set_hmax - Function for programming the 1H time
+ * @priv: Pointer to device structure
+ *
+ * Writes the line length computed for the mode, output width and link.
  *
  * Return: 0 on success
  */
-static int imx547_g_frame_interval(struct v4l2_subdev *sd,
-                   struct v4l2_subdev_state *sd_state,
-                   struct v4l2_subdev_frame_interval *fi)
+static int imx547_set_hmax(struct stimx547 *priv)
 {
-    struct stimx547 *imx547 = to_imx547(sd);
+    int err;
 
-    fi->interval = imx547->frame_interval;
-    dev_dbg(&imx547->client->dev, "%s frame rate = %d / %d\n", __func__, imx547->frame_interval.numerator, imx547->frame_interval.denominator);
+    err = imx547_update_mbreg(priv, IMX547_DIRTY_TIMING, HMAX_LOW,
+                  priv->hmax, 2);
+    if (err) {
+        dev_err(&priv->client->dev, "%s: unable to write hmax\n", __func__);
+        return err;
+    }
+
+    dev_dbg(&priv->client->dev, "%s: hmax: %u [inck], line_time: %llu [ns]\n",
+            __func__, priv->hmax, imx547_timing_ns(priv->hmax, 1));
 
     return 0;
 }
 
-/**
- * imx547_s_frame_interval - Set the frame interval
- * @sd: Pointer to V4L2 Sub device structure
- * @sd_state: Pointer to V4L2 Sub device state information structure
- * @fi: Pointer to V4l2 Sub device frame interval structure
+
+/*
+ * imx547_set_frame_length - Function called when setting frame length
+ * @priv: Pointer to device structure
  *
- * This function is used to set the frame interval.
+ * Set frame length.
  *
  * Return: 0 on success
  */
-static int imx547_s_frame_interval(struct v4l2_subdev *sd,
-                   struct v4l2_subdev_state *sd_state,
-                   struct v4l2_subdev_frame_interval *fi)
+static int imx547_set_frame_length(struct stimx547 *priv)
 {
-    struct stimx547 *imx547 = to_imx547(sd);
-    struct v4l2_ctrl *ctrl = imx547->ctrls.exposure;
-    int min, max, def;
-    int ret;
-    u32 min_reg_shs;
+    int err;
+    u32 frame_length_32bit;
 
-    mutex_lock(&imx547->lock);
-    imx547->frame_interval = fi->interval;
-    ret = imx547_set_frame_interval(imx547);
-    if (!ret) {
-        /*
-         * exposure time range is decided by frame interval
-         * need to update it after frame interval changes
-         */
+    frame_length_32bit = (u32)priv->frame_length;
 
-        switch (imx547->format.code) {
-            case MEDIA_BUS_FMT_SRGGB10_1X10:
-            case MEDIA_BUS_FMT_Y10_1X10:
-                min_reg_shs = IMX547_MIN_SHS_LENGTH_10BIT;
-                break;
-            case MEDIA_BUS_FMT_SRGGB12_1X12:
-            case MEDIA_BUS_FMT_Y12_1X12:
-                min_reg_shs = IMX547_MIN_SHS_LENGTH_12BIT;
-                break;
-            default:
-                dev_err(&imx547->client->dev, "%s: Cannot find minimum SHS\n", __func__);
-                return -EINVAL;
-        }
+    err = imx547_update_mbreg(priv, IMX547_DIRTY_TIMING, VMAX_LOW,
+                  frame_length_32bit, 3);
+    if (err) {
+        dev_err(&priv->client->dev, "%s unable to write vmax\n", __func__);
+        return err;
+    }
 
-        min = IMX547_MIN_EXPOSURE_TIME;
-        max = (imx547->frame_length - min_reg_shs) * imx547->line_time / IMX547_K_FACTOR;
-        def = max;
-        if (__v4l2_ctrl_modify_range(ctrl, min, max, 1, def)) {
-            dev_err(&imx547->client->dev,
-                "Exposure ctrl range update failed\n");
-            goto unlock;
-        }
+    dev_dbg(&priv->client->dev, "%s : input length = %llu\n", __func__, priv->frame_length);
+
+    return 0;
+}
 
-        /* update exposure time accordingly */
-        imx547_set_exposure(imx547, ctrl->val);
+/*
+ * imx547_set_frame_interval - Function called when setting frame interval
+ * @priv: Pointer to device structure
+ *
+ * Change frame interval by updating VMAX value
+ * The caller should hold the mutex lock imx547->lock if necessary
+ *
+ * Return: 0 on success
+ */
+static int imx547_set_frame_interval(struct stimx547 *priv)
+{
+    int err;
+    u32 frame_length, min_frame_length, max_frame_length;
+    struct v4l2_fract max_fi, slowest = { 1, IMX547_MIN_FRAME_RATE };
+    const struct imx547_mode *mode = priv->mode;
 
-        dev_dbg(&imx547->client->dev, "set frame interval to %llu us\n", fi->interval.numerator * IMX547_M_FACTOR / fi->interval.denominator);
+	dev_dbg(&priv->client->dev, "%s: input frame interval = %d / %d", 
+			__func__, priv->frame_interval.numerator, priv->frame_interval.denominator);
+
+    if (priv->frame_interval.numerator == 0 || priv->frame_interval.denominator == 0) {
+        priv->frame_interval.denominator = IMX547_DEF_FRAME_RATE;
+        priv->frame_interval.numerator = 1;
     }
 
-unlock:
-    mutex_unlock(&imx547->lock);
+    min_frame_length = imx547_min_interval(mode, priv->crop.height,
+                           priv->hmax, &max_fi);
+    max_frame_length = imx547_timing_vmax(priv->hmax, &slowest);
 
-    return ret;
+    /* boundary check, in lines so the achieved interval is exact */
+    frame_length = imx547_timing_vmax(priv->hmax, &priv->frame_interval);
+    frame_length = clamp(frame_length, min_frame_length, max_frame_length);
+
+    priv->frame_length = frame_length;
+    priv->frame_ns = imx547_timing_ns(priv->hmax, frame_length);
+    imx547_timing_interval(priv->hmax, frame_length, &priv->frame_interval);
+    dev_dbg(&priv->client->dev, "%s: hmax: %u, frame_length: %u, frame interval = %u / %u\n",
+            __func__, priv->hmax, frame_length,
+            priv->frame_interval.numerator, priv->frame_interval.denominator);
+
+    err = imx547_set_frame_length(priv);
+    if (!err)
+        err = imx547_update_blanking(priv);
+    if (err)
+        goto fail;
+
+    return 0;
+
+fail:
+    dev_err(&priv->client->dev, "%s error = %d\n", __func__, err);
+    return err;
 }
 
 /**
- * imx547_s_stream - It is used to start/stop the streaming.
- * @sd: V4L2 Sub device
- * @on: Flag (True / False)
- *
- * This function controls the start or stop of streaming for the
- * imx547 sensor.
+ * imx547_subscribe_event - Subscribe to a subdev event
+ * @sd: Pointer to V4L2 Sub device structure
+ * @fh: Pointer to V4L2 file handle
+ * @sub: Pointer to V4L2 event subscription
  *
  * Return: 0 on success, errors otherwise
  */
-static int imx547_s_stream(struct v4l2_subdev *sd, int on)
+static int imx547_subscribe_event(struct v4l2_subdev *sd, struct v4l2_fh *fh,
+                  struct v4l2_event_subscription *sub)
 {
-    struct stimx547 *imx547 = to_imx547(sd);
-    int ret = 0;
+    struct stimx547 *priv = to_imx547(sd);
 
-    mutex_lock(&imx547->lock);
+    switch (sub->type) {
+    case IMX547_EVENT_STREAM_STARTED:
+        return v4l2_event_subscribe(fh, sub, 2, NULL);
+    case IMX547_EVENT_QUEUE_MISSED:
+        if (!priv->xvs_irq)
+            return -EINVAL;
+        return v4l2_event_subscribe(fh, sub, IMX547_FRAME_SYNC_EVENTS, NULL);
+    case V4L2_EVENT_FRAME_SYNC:
+        if (!priv->xvs_irq)
+            return -EINVAL;
+        return v4l2_event_subscribe(fh, sub, IMX547_FRAME_SYNC_EVENTS, NULL);
+    default:
+        return v4l2_ctrl_subdev_subscribe_event(sd, fh, sub);
+    }
+}
 
-    if (on) {
+static const struct v4l2_subdev_core_ops imx547_core_ops = {
+    .subscribe_event = imx547_subscribe_event,
+    .unsubscribe_event = v4l2_event_subdev_unsubscribe,
+};
 
-        /* load common registers */
-        ret = imx547_common_regs(imx547);
-        if (ret)
-            goto fail;
+static const struct v4l2_subdev_pad_ops imx547_pad_ops = {
+    .enum_mbus_code = imx547_enum_mbus_code,
+    .enum_frame_size = imx547_enum_frame_size,
+    .enum_frame_interval = imx547_enum_frame_interval,
+    .get_fmt = imx547_get_fmt,
+    .set_fmt = imx547_set_fmt,
+    .get_selection = imx547_get_selection,
+    .set_selection = imx547_set_selection,
+    .get_frame_desc = imx547_get_frame_desc,
+    .get_mbus_config = imx547_get_mbus_config,
+    .get_frame_interval = imx547_g_frame_interval,
+    .set_frame_interval = imx547_s_frame_interval,
+};
 
-         /* load pixel format registers */
-        ret = imx547_set_pixel_format(imx547);
-        if (ret)
-            goto fail;
+static const struct v4l2_subdev_video_ops imx547_video_ops = {
+    .s_stream = imx547_s_stream,
+};
 
-        /* calculate line time */
-        ret = imx547_calculate_line_time(imx547);
-        if (ret)
-            goto fail;
+static const struct v4l2_subdev_ops imx547_subdev_ops = {
+    .core = &imx547_core_ops,
+    .pad = &imx547_pad_ops,
+    .video = &imx547_video_ops,
+};
 
-        /* update frame interval */
-        ret = imx547_set_frame_interval(imx547);
-        if (ret)
-            goto fail;
+static const struct v4l2_subdev_internal_ops imx547_internal_ops = {
+    .init_state = imx547_init_state,
+};
 
-        /* update exposure time */
-        ret = imx547_set_exposure(imx547, imx547->ctrls.exposure->val);
-        if (ret)
-            goto fail;
+static const struct v4l2_ctrl_ops imx547_ctrl_ops = {
+    .try_ctrl = imx547_try_ctrl,
+    .s_ctrl = imx547_s_ctrl,
+    .g_volatile_ctrl = imx547_g_volatile_ctrl,
+};
 
-        /* start stream */
-        ret = imx547_start_stream(imx547);
-        if (ret)
-            goto fail;
-    } else {
-        /* stop stream */
-        ret = imx547_stop_stream(imx547);
-        if (ret)
-            goto fail;
-    }
+static const struct v4l2_ctrl_config imx547_trigger_mode_ctrl = {
+    .ops = &imx547_ctrl_ops,
+    .id = IMX547_CID_TRIGGER_MODE,
+    .name = "Trigger Mode",
+    .type = V4L2_CTRL_TYPE_MENU,
+    .max = ARRAY_SIZE(trigger_qmenu) - 1,
+    .def = IMX547_TRIGGER_FREE_RUN,
+    .qmenu = trigger_qmenu,
+};
 
-    mutex_unlock(&imx547->lock);
-    dev_dbg(&imx547->client->dev, "%s : Done\n", __func__);
-    return 0;
+static const struct v4l2_ctrl_config imx547_trigger_delay_ctrl = {
+    .ops = &imx547_ctrl_ops,
+    .id = IMX547_CID_TRIGGER_DELAY,
+    .name = "Trigger to Readout Delay",
+    .type = V4L2_CTRL_TYPE_INTEGER,
+    .flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE |
+         V4L2_CTRL_FLAG_INACTIVE,
+    .min = 0,
+    .max = IMX547_MAX_EXPOSURE_TIME + IMX547_M_FACTOR,
+    .step = 1,
+    .def = 0,
+};
 
-fail:
-    mutex_unlock(&imx547->lock);
-    dev_err(&imx547->client->dev, "s_stream failed\n");
-    return ret;
+static const struct v4l2_ctrl_config imx547_frame_queue_ctrl = {
+    .ops = &imx547_ctrl_ops,
+    .id = IMX547_CID_FRAME_QUEUE,
+    .name = "Frame Control Queue",
+    .type = V4L2_CTRL_TYPE_U32,
+    .flags = V4L2_CTRL_FLAG_DYNAMIC_ARRAY,
+    .max = U32_MAX,
+    .step = 1,
+    .dims = { IMX547_QUEUE_MAX * IMX547_QUEUE_TUPLE },
+};
+
+static const struct v4l2_ctrl_config imx547_queue_delay_ctrl = {
+    .id = IMX547_CID_FRAME_QUEUE_DELAY,
+    .name = "Frame Control Queue Delay",
+    .type = V4L2_CTRL_TYPE_INTEGER,
+    .flags = V4L2_CTRL_FLAG_READ_ONLY,
+    .min = IMX547_QUEUE_MIN_DELAY,
+    .max = IMX547_QUEUE_MIN_DELAY,
+    .step = 1,
+    .def = IMX547_QUEUE_MIN_DELAY,
+};
+
+
+/*
+ * imx547_parse_budgets - Read the timing budgets from device tree
+ * @priv: Pointer to device structure
+ */
+static void imx547_parse_budgets(struct stimx547 *priv)
+{
+    struct device *dev = &priv->client->dev;
+    const struct imx547_budget_desc *desc;
+    u32 us;
+    int i;
+
+    for (i = 0; i < IMX547_BUDGET_NUM; i++) {
+        desc = &imx547_budgets[i];
+
+        if (device_property_read_u32(dev, desc->prop, &us))
+            us = desc->def_us;
+
+        if (us < desc->min_us) {
+            dev_warn(dev, "%s %u us below datasheet minimum, using %u us\n",
+                 desc->prop, us, desc->min_us);
+            us = desc->min_us;
+        }
+
+        priv->budget_us[i] = us;
+        dev_dbg(dev, "%s: %s budget %u us\n", __func__, desc->name, us);
+    }
 }
 
+/*
+ * imx547_parse_trigger_latency - Read the measured trigger latency
+ * @priv: Pointer to device structure
+ *
+ * The latency depends on the trigger path of the board and has no
+ * datasheet value, so there is no default.
+ */
+static void imx547_parse_trigger_latency(struct stimx547 *priv)
+{
+    struct device *dev = &priv->client->dev;
+    u32 us;
+
+    if (device_property_read_u32(dev, "framos,trigger-latency-us", &us))
+        return;
+
+    if (us > IMX547_M_FACTOR) {
+        dev_warn(dev, "framos,trigger-latency-us %u us out of range, ignored\n",
+             us);
+        return;
+    }
+
+    priv->trigger_latency_us = us;
+}
 
 /*
- * imx547_set_gain - Function called when setting gain
+ * imx547_parse_lanes - Read the lane count from the device tree endpoint
  * @priv: Pointer to device structure
- * @val: Value of gain
  *
- * Set the gain based on input value.
- * The caller should hold the mutex lock imx547->lock if necessary
+ * Without an endpoint or data-lanes property all lanes are used.
  *
- * Return: 0 on success
+ * Return: 0 on success, -EINVAL for an unsupported lane count
  */
-static int imx547_set_gain(struct stimx547 *priv, int val)
+static int imx547_parse_lanes(struct stimx547 *priv)
 {
-    
-    int err;
-
-    err = imx547_write_mbreg(priv, GAIN_LOW, val, 2);
-    if (err){
-        dev_dbg(&priv->client->dev, "%s: GAIN control error\n", __func__);
-        return err;
+    struct device *dev = &priv->client->dev;
+    struct fwnode_handle *ep;
+    int lanes;
+
+    ep = fwnode_graph_get_next_endpoint(dev_fwnode(dev), NULL);
+    if (!ep)
+        return 0;
+
+    lanes = fwnode_property_count_u32(ep, "data-lanes");
+    fwnode_handle_put(ep);
+    if (lanes <= 0)
+        return 0;
+
+    if (lanes > IMX547_MAX_LANES || !is_power_of_2(lanes)) {
+        dev_err(dev, "unsupported number of data lanes %d\n", lanes);
+        return -EINVAL;
     }
 
-    /* update gain */
-    priv->ctrls.gain->val = val;
+    priv->lanes = lanes;
+    dev_dbg(dev, "%s: %d data lanes\n", __func__, lanes);
+
+    return 0;
+}
+
+/*
+ * imx547_tables_show - Report the I2C cost of each register table
+ * @s: Pointer to seq_file
+ * @data: Unused
+ *
+ * Lists runs, registers and transactions for a full write of each table,
+ * next to the transactions the former 16 byte coalescing needed.
+ *
+ * Return: 0
+ */
+static int imx547_tables_show(struct seq_file *s, void *data)
+{
+    struct stimx547 *priv = s->private;
+    size_t max_burst = regmap_get_raw_write_max(priv->regmap);
+    const struct imx547_reg_table *table;
+    const char *name;
+    unsigned int i, j, regs;
+
+    seq_printf(s, "%-12s %6s %6s %6s %6s\n",
+           "table", "runs", "regs", "xfers", "was");
+
+    for (i = 0; i <= IMX547_MODE_NUM; i++) {
+        if (i == 0) {
+            name = "common";
+            table = priv->common;
+        } else {
+            name = priv->modes[i - 1].name;
+            table = priv->modes[i - 1].regs;
+        }
+
+        regs = 0;
+        for (j = 0; j < table->num_runs; j++)
+            regs += table->runs[j].len;
 
-    dev_dbg(&priv->client->dev, "%s:  gain val [%d]\n",  __func__, val);
+        seq_printf(s, "%-12s %6u %6u %6u %6u\n", name,
+               table->num_runs, regs,
+               imx547_table_xfers(table, max_burst),
+               imx547_table_xfers(table, 16));
+    }
 
     return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(imx547_tables);
 
 /*
- * imx547_set_black_level - Function called when setting black level
+ * imx547_debugfs_init - Expose timing budgets and measured latencies
  * @priv: Pointer to device structure
- * @val: Value of black level
- *
- * Set the black level based on input value.
- * The caller should hold the mutex lock imx547->lock if necessary
- *
- * Return: 0 on success
  */
-static int imx547_set_black_level(struct stimx547 *priv, int val)
+static void imx547_debugfs_init(struct stimx547 *priv)
 {
-    
-    int err;
+    char name[32];
+    int i;
 
-    err = imx547_write_mbreg(priv, BLKLEVEL_LOW, val, 2);
-    if (err){
-        dev_dbg(&priv->client->dev, "%s: BLKLEVEL control error\n", __func__);
-        return err;
+    snprintf(name, sizeof(name), "imx547-%s", dev_name(&priv->client->dev));
+    priv->debugfs = debugfs_create_dir(name, NULL);
+
+    for (i = 0; i < IMX547_BUDGET_NUM; i++) {
+        snprintf(name, sizeof(name), "%s_us", imx547_budgets[i].name);
+        debugfs_create_u32(name, 0444, priv->debugfs, &priv->budget_us[i]);
     }
 
-    /* update black level */
-    priv->ctrls.black_level->val = val;
+    debugfs_create_u32("start_latency_us", 0444, priv->debugfs,
+               &priv->start_latency_us);
+    debugfs_create_u32("stop_latency_us", 0444, priv->debugfs,
+               &priv->stop_latency_us);
+    debugfs_create_u32("resume_latency_us", 0444, priv->debugfs,
+               &priv->resume_latency_us);
+    debugfs_create_u32("frame_sequence", 0444, priv->debugfs,
+               &priv->frame_sequence);
+    debugfs_create_u32("queue_missed", 0444, priv->debugfs,
+               &priv->queue_missed);
+    debugfs_create_file("tables", 0444, priv->debugfs, priv,
+                &imx547_tables_fops);
+}
 
-    dev_dbg(&priv->client->dev, "%s:  black level val [%d]\n",  __func__, val);
+/*
+ * imx547_regs_writable - Check that a run lies in the register map
+ * @addr: Start address
+ * @len: Number of registers
+ *
+ * Return: true if all registers of the run are writable
+ */
+static bool imx547_regs_writable(u16 addr, u16 len)
+{
+    unsigned int last = addr + len - 1;
+    int i;
 
-    return 0;
+    for (i = 0; i < ARRAY_SIZE(imx547_regmap_ranges); i++) {
+        if (addr >= imx547_regmap_ranges[i].range_min &&
+            last <= imx547_regmap_ranges[i].range_max)
+            return true;
+    }
+
+    return false;
 }
 
 /*
- * imx547_set_exposure - Function called when setting exposure time
+ * imx547_parse_pack_runs - Build a register table from mode pack runs
  * @priv: Pointer to device structure
- * @val: Variable for exposure time, in the unit of micro-second
- *
- * Set exposure time based on input value.
- * The caller should hold the mutex lock imx547->lock if necessary
+ * @data: Run data, kept alive for the lifetime of the device
+ * @size: Size of run data in bytes
+ * @num_runs: Number of runs
+ * @table: Table to fill
  *
- * Return: 0 on success
+ * Return: 0 on success, errors otherwise
  */
-static int imx547_set_exposure(struct stimx547 *priv, int val)
+static int imx547_parse_pack_runs(struct stimx547 *priv, const u8 *data,
+                  size_t size, unsigned int num_runs,
+                  struct imx547_reg_table *table)
 {
-    
-    int err = 0;
-    u32 integration_time_line;
-    u32 reg_shs, min_reg_shs;
-
-    dev_dbg(&priv->client->dev, "%s: integration time: %d [us]\n", __func__, val);
+    const struct imx547_fw_run *run;
+    struct imx547_reg_run *runs;
+    size_t off = 0;
+    unsigned int i;
+    u16 addr, len;
 
-    /* Check value with internal range */
-    if (val > priv->ctrls.exposure->maximum) {
-        val = priv->ctrls.exposure->maximum;
-    }
-    else if (val < priv->ctrls.exposure->minimum) {
-        val = priv->ctrls.exposure->minimum;
-    }
+    if (!num_runs)
+        return -EINVAL;
 
-    integration_time_line = (val * IMX547_K_FACTOR) / priv->line_time ;
+    runs = devm_kcalloc(&priv->client->dev, num_runs, sizeof(*runs), GFP_KERNEL);
+    if (!runs)
+        return -ENOMEM;
 
-    reg_shs = priv->frame_length - integration_time_line;
-    
-    switch (priv->format.code) {
-        case MEDIA_BUS_FMT_SRGGB10_1X10:
-        case MEDIA_BUS_FMT_Y10_1X10:
-            min_reg_shs = IMX547_MIN_SHS_LENGTH_10BIT;
-            break;
-        case MEDIA_BUS_FMT_SRGGB12_1X12:
-        case MEDIA_BUS_FMT_Y12_1X12:
-            min_reg_shs = IMX547_MIN_SHS_LENGTH_12BIT;
-            break;
-        default:
-            dev_err(&priv->client->dev, "%s: Cannot find minimum SHS\n", __func__);
+    for (i = 0; i < num_runs; i++) {
+        if (size - off < sizeof(*run))
             return -EINVAL;
-    }
 
-    if (reg_shs < min_reg_shs)
-        reg_shs = min_reg_shs;
-    else if (reg_shs > (priv->frame_length - 1))
-        reg_shs = priv->frame_length - 1;
+        run = (const struct imx547_fw_run *)(data + off);
+        addr = le16_to_cpu(run->addr);
+        len = le16_to_cpu(run->len);
+        off += sizeof(*run);
 
-    err = imx547_write_mbreg(priv, SHS_LOW, reg_shs, 3);
-    if (err) {
-        dev_err(&priv->client->dev, "%s: failed to set exposure\n", __func__);
-        return err;
+        if (!len || size - off < len || !imx547_regs_writable(addr, len)) {
+            dev_err(&priv->client->dev, "%s: bad run %u at 0x%04x (%u bytes)\n",
+                __func__, i, addr, len);
+            return -EINVAL;
+        }
+
+        runs[i].addr = addr;
+        runs[i].len = len;
+        runs[i].vals = data + off;
+        off += len;
     }
 
-    /* update exposure time */
-    priv->ctrls.exposure->val = val;
+    if (off != size)
+        return -EINVAL;
 
-    dev_dbg(&priv->client->dev,
-     "%s: set integration time: %d [us], coarse1:%d [line], shs: %d [line], frame length: %llu [line]\n",
-     __func__, val, integration_time_line, reg_shs, priv->frame_length);
+    table->runs = runs;
+    table->num_runs = num_runs;
 
-    return err;
+    return 0;
 }
 
 /*
- * imx547_set_test_pattern - Function called when setting test pattern
+ * imx547_parse_mode_pack - Validate a mode pack and apply it
  * @priv: Pointer to device structure
- * @val: Variable for test pattern
+ * @data: Mode pack contents, kept alive for the lifetime of the device
+ * @size: Size of the mode pack in bytes
  *
- * Set to different test patterns based on input value.
+ * Nothing is applied unless the whole pack is valid.
  *
- * Return: 0 on success
+ * Return: 0 on success, errors otherwise
  */
-static int imx547_set_test_pattern(struct stimx547 *priv, int val)
+static int imx547_parse_mode_pack(struct stimx547 *priv, const u8 *data,
+                  size_t size)
 {
-
+    struct imx547_reg_table tables[IMX547_FW_SECTION_NUM] = { };
+    struct imx547_mode modes[IMX547_MODE_NUM];
+    const struct imx547_fw_header *hdr;
+    const struct imx547_fw_section *sec;
+    struct imx547_mode *mode;
+    unsigned int i, type, num_sections;
+    size_t off;
+    u32 sec_size;
     int err;
 
-    if (val) {
-        err = imx547_write_reg(priv, 0x3550, 0x07);
-        if (err) 
-            goto fail;
+    if (size < sizeof(*hdr))
+        return -EINVAL;
 
-        err = imx547_write_reg(priv, 0x3551, (u8)(val));
-        if (err) 
-            goto fail;
-    }
-    else {
-        err = imx547_write_reg(priv, 0x3550, 0x06);
-        if (err) 
-            goto fail;
+    hdr = (const struct imx547_fw_header *)data;
+    if (le32_to_cpu(hdr->magic) != IMX547_FW_MAGIC ||
+        le16_to_cpu(hdr->version) != IMX547_FW_VERSION) {
+        dev_err(&priv->client->dev, "%s: unsupported mode pack\n", __func__);
+        return -EINVAL;
     }
 
-    return 0;
+    memcpy(modes, priv->modes, sizeof(modes));
+    num_sections = le16_to_cpu(hdr->num_sections);
+    off = sizeof(*hdr);
 
-fail:
-    dev_err(&priv->client->dev, "%s: error setting test pattern\n", __func__);
-    return err;
-}
+    for (i = 0; i < num_sections; i++) {
+        if (size - off < sizeof(*sec))
+            return -EINVAL;
 
+        sec = (const struct imx547_fw_section *)(data + off);
+        off += sizeof(*sec);
 
-/*
- * imx547_set_exposure - Function for calculating 1H time
- * @priv: Pointer to device structure
- *
- * Calculate line time based on HMAX value.
- *
- * Return: 0 on success
- */
-static int imx547_calculate_line_time(struct stimx547 *priv)
-{
-    u32 hmax;
-    int err;
+        sec_size = le32_to_cpu(sec->size);
+        if (size - off < sec_size)
+            return -EINVAL;
 
-    err = imx547_read_mbreg(priv, HMAX_LOW, &hmax, 2);
-    if (err) {
-        dev_err(&priv->client->dev, "%s: unable to read hmax\n", __func__);
-        return err;
+        type = le16_to_cpu(sec->type);
+        if (type >= IMX547_FW_SECTION_NUM || tables[type].runs) {
+            dev_err(&priv->client->dev, "%s: bad section type %u\n",
+                __func__, type);
+            return -EINVAL;
+        }
+
+        err = imx547_parse_pack_runs(priv, data + off, sec_size,
+                         le16_to_cpu(sec->num_runs), &tables[type]);
+        if (err)
+            return err;
+        off += sec_size;
+
+        if (type == IMX547_FW_COMMON)
+            continue;
+
+        mode = &modes[type - 1];
+        mode->hmax = le32_to_cpu(sec->hmax);
+        mode->vmax = le32_to_cpu(sec->vmax);
+        mode->min_shs = le32_to_cpu(sec->min_shs);
+
+        if (!mode->hmax || mode->hmax > IMX547_MAX_HMAX ||
+            mode->vmax > IMX547_MAX_VMAX ||
+            mode->vmax < IMX547_DEFAULT_HEIGHT + IMX547_MIN_VBLANK ||
+            mode->min_shs >= mode->vmax) {
+            dev_err(&priv->client->dev, "%s: bad timing in section %u\n",
+                __func__, type);
+            return -EINVAL;
+        }
     }
 
-    priv->line_time = (hmax*IMX547_G_FACTOR) / (IMX547_INCK);
+    if (off != size)
+        return -EINVAL;
 
+    for (i = 0; i < IMX547_FW_SECTION_NUM; i++) {
+        if (!tables[i].runs)
+            continue;
 
-    dev_dbg(&priv->client->dev, "%s: hmax: %u [inck], line_time: %u [ns]\n",
-            __func__, hmax, priv->line_time);
+        priv->pack_tables[i] = tables[i];
+        if (i == IMX547_FW_COMMON)
+            priv->common = &priv->pack_tables[i];
+        else
+            modes[i - 1].regs = &priv->pack_tables[i];
+    }
+    memcpy(priv->modes, modes, sizeof(priv->modes));
 
     return 0;
 }
 
-
 /*
- * imx547_set_frame_length - Function called when setting frame length
+ * imx547_load_mode_pack - Load an optional mode pack firmware
  * @priv: Pointer to device structure
  *
- * Set frame length.
- *
- * Return: 0 on success
+ * The pack is named by the mode_pack module parameter or the
+ * firmware-name DT property. The built-in tables stay in use if there is
+ * none or it fails validation.
  */
-static int imx547_set_frame_length(struct stimx547 *priv)
+static void imx547_load_mode_pack(struct stimx547 *priv)
 {
+    struct device *dev = &priv->client->dev;
+    const struct firmware *fw;
+    const char *name = mode_pack;
+    const u8 *data;
+    void *group;
     int err;
-    u32 frame_length_32bit;
 
-    frame_length_32bit = (u32)priv->frame_length;
+    if ((!name || !*name) &&
+        device_property_read_string(dev, "firmware-name", &name))
+        return;
 
-    err = imx547_write_mbreg(priv, VMAX_LOW, frame_length_32bit, 3);
+    err = request_firmware(&fw, name, dev);
     if (err) {
-        dev_err(&priv->client->dev, "%s unable to write vmax\n", __func__);
-        return err;
+        dev_warn(dev, "mode pack %s not loaded (%d), using built-in modes\n",
+             name, err);
+        return;
     }
 
-    dev_dbg(&priv->client->dev, "%s : input length = %llu\n", __func__, priv->frame_length);
+    /* runs point into this copy, so it lives as long as the device */
+    group = devres_open_group(dev, NULL, GFP_KERNEL);
+    data = group ? devm_kmemdup(dev, fw->data, fw->size, GFP_KERNEL) : NULL;
+    err = data ? imx547_parse_mode_pack(priv, data, fw->size) : -ENOMEM;
+    release_firmware(fw);
+
+    if (group) {
+        /* a rejected pack frees its copy and runs right away */
+        if (err)
+            devres_release_group(dev, group);
+        else
+            devres_remove_group(dev, group);
+    }
 
-    return 0;
+    if (err) {
+        dev_err(dev, "mode pack %s rejected (%d), using built-in modes\n",
+            name, err);
+        return;
+    }
+
+    dev_info(dev, "using mode pack %s\n", name);
 }
 
 /*
- * imx547_set_frame_interval - Function called when setting frame interval
+ * imx547_init_defaults - Set the power-on configuration
  * @priv: Pointer to device structure
  *
- * Change frame interval by updating VMAX value
- * The caller should hold the mutex lock imx547->lock if necessary
- *
- * Return: 0 on success
+ * Full window in the 12 bit mode at the default frame rate, built-in
+ * tables and all lanes. Nothing is written to the sensor, the register
+ * cache starts out dirty.
  */
-static int imx547_set_frame_interval(struct stimx547 *priv)
+static void imx547_init_defaults(struct stimx547 *priv)
 {
-    int err;
-    u64 frame_length;
-    u64 req_frame_rate;
-    u32 max_frame_rate;
+    priv->format.width = IMX547_DEFAULT_WIDTH;
+    priv->format.height = IMX547_DEFAULT_HEIGHT;
+    priv->crop.width = IMX547_DEFAULT_WIDTH;
+    priv->crop.height = IMX547_DEFAULT_HEIGHT;
+    priv->format.field = V4L2_FIELD_NONE;
+    priv->format.code = MEDIA_BUS_FMT_SRGGB12_1X12;
+    priv->format.colorspace = V4L2_COLORSPACE_SRGB;
+    priv->frame_interval.numerator = 1;
+    priv->frame_interval.denominator = IMX547_DEF_FRAME_RATE;
+    priv->common = &imx547_common_settings;
+    memcpy(priv->modes, imx547_builtin_modes, sizeof(priv->modes));
+    priv->mode = &priv->modes[IMX547_MODE_12BIT];
+    priv->lanes = IMX547_DEF_LANES;
+    imx547_mark_regs_lost(priv);
+}
 
-	dev_dbg(&priv->client->dev, "%s: input frame interval = %d / %d", 
-			__func__, priv->frame_interval.numerator, priv->frame_interval.denominator);
+/*
+ * imx547_init_controls - Create the V4L2 controls
+ * @priv: Pointer to device structure
+ *
+ * Ranges that follow the timing are set for the current mode, crop and
+ * frame interval. HBLANK, PIXEL_RATE, LINK_FREQ and the queue delay only
+ * report driver state and have no ops, so range updates never reach
+ * imx547_s_ctrl().
+ *
+ * Return: 0 on success, errors otherwise
+ */
+static int imx547_init_controls(struct stimx547 *priv)
+{
+    struct imx547_ctrls *ctrls = &priv->ctrls;
+    u32 hblank;
+    int ret;
 
-    if (priv->frame_interval.numerator == 0 || priv->frame_interval.denominator == 0) {
-        priv->frame_interval.denominator = IMX547_DEF_FRAME_RATE;
-        priv->frame_interval.numerator = 1;
+    ret = v4l2_ctrl_handler_init(&ctrls->handler, 12);
+    if (ret < 0) {
+        dev_err(&priv->client->dev,
+            "%s : ctrl handler init Failed\n", __func__);
+        return ret;
     }
 
-    req_frame_rate = IMX547_M_FACTOR * priv->frame_interval.denominator / priv->frame_interval.numerator;
+    ctrls->handler.lock = &priv->lock;
 
-    switch (priv->format.code) {
-        case MEDIA_BUS_FMT_SRGGB10_1X10:
-        case MEDIA_BUS_FMT_Y10_1X10:
-            max_frame_rate = IMX547_M_FACTOR * IMX547_MAX_FRAME_INTERVAL_10BIT_DENOMINATOR / IMX547_MAX_FRAME_INTERVAL_10BIT_NUMERATOR;
-            break;
-        case MEDIA_BUS_FMT_SRGGB12_1X12:
-        case MEDIA_BUS_FMT_Y12_1X12:
-            max_frame_rate = IMX547_M_FACTOR * IMX547_MAX_FRAME_INTERVAL_12BIT_DENOMINATOR / IMX547_MAX_FRAME_INTERVAL_12BIT_NUMERATOR;
-            break;
-        default:
-            dev_err(&priv->client->dev, "%s: Cannot find maximum frame rate\n", __func__);
-            return -EINVAL;
-    }
+    /* add new controls */
+    ctrls->test_pattern = v4l2_ctrl_new_std_menu_items(
+        &ctrls->handler, &imx547_ctrl_ops,
+        V4L2_CID_TEST_PATTERN,
+        ARRAY_SIZE(tp_qmenu) - 1, 0, 0, tp_qmenu);
 
-    /* boundary check */
-    if (req_frame_rate > max_frame_rate) {
-        switch (priv->format.code) {
-            case MEDIA_BUS_FMT_SRGGB10_1X10:
-            case MEDIA_BUS_FMT_Y10_1X10:
-                priv->frame_interval.numerator = IMX547_MAX_FRAME_INTERVAL_10BIT_NUMERATOR;
-                priv->frame_interval.denominator = IMX547_MAX_FRAME_INTERVAL_10BIT_DENOMINATOR ;
-                break;
-            case MEDIA_BUS_FMT_SRGGB12_1X12:
-            case MEDIA_BUS_FMT_Y12_1X12:
-                priv->frame_interval.numerator = IMX547_MAX_FRAME_INTERVAL_12BIT_NUMERATOR;
-                priv->frame_interval.denominator = IMX547_MAX_FRAME_INTERVAL_12BIT_DENOMINATOR ;
-                break;
-            default:
-                dev_err(&priv->client->dev, "%s: Frame interval setting error\n", __func__);
-                return -EINVAL;
-        }
-    } else if (req_frame_rate < (IMX547_MIN_FRAME_RATE * IMX547_M_FACTOR)) {
-        priv->frame_interval.numerator = 1;
-        priv->frame_interval.denominator = IMX547_MIN_FRAME_RATE;
+    ctrls->gain = v4l2_ctrl_new_std(
+        &ctrls->handler,
+        &imx547_ctrl_ops,
+        V4L2_CID_GAIN, IMX547_MIN_GAIN,
+        IMX547_MAX_GAIN, 1,
+        IMX547_DEF_GAIN);
+
+    ctrls->exposure = v4l2_ctrl_new_std(
+        &ctrls->handler,
+        &imx547_ctrl_ops,
+        V4L2_CID_EXPOSURE, IMX547_MIN_EXPOSURE_TIME,
+        IMX547_M_FACTOR / IMX547_DEF_FRAME_RATE, 1,
+        IMX547_DEF_EXPOSURE_TIME);
+
+    ctrls->black_level = v4l2_ctrl_new_std(
+        &ctrls->handler,
+        &imx547_ctrl_ops,
+        V4L2_CID_BLACK_LEVEL, IMX547_MIN_BLACK_LEVEL,
+        priv->mode->max_black_level, 1,
+        priv->mode->def_black_level);
+
+    ctrls->trigger_mode = v4l2_ctrl_new_custom(
+        &ctrls->handler, &imx547_trigger_mode_ctrl, NULL);
+
+    /* the delay is only reported once the board latency is measured */
+    if (priv->trigger_latency_us)
+        ctrls->trigger_delay = v4l2_ctrl_new_custom(
+            &ctrls->handler, &imx547_trigger_delay_ctrl, NULL);
+
+    /* the queue is paced by XVS, its frame delay only holds with it */
+    if (priv->xvs_irq) {
+        ctrls->frame_queue = v4l2_ctrl_new_custom(
+            &ctrls->handler, &imx547_frame_queue_ctrl, NULL);
+
+        ctrls->queue_delay = v4l2_ctrl_new_custom(
+            &ctrls->handler, &imx547_queue_delay_ctrl, NULL);
     }
 
-    req_frame_rate = IMX547_M_FACTOR * priv->frame_interval.denominator / priv->frame_interval.numerator;
+    hblank = priv->hmax * IMX547_PIXELS_PER_INCK - priv->format.width;
+    ctrls->hblank = v4l2_ctrl_new_std(
+        &ctrls->handler, NULL,
+        V4L2_CID_HBLANK, hblank, hblank, 1, hblank);
 
-    frame_length = (IMX547_M_FACTOR * IMX547_G_FACTOR) / (req_frame_rate * priv->line_time);
-    priv->frame_length = frame_length;
-    dev_dbg(&priv->client->dev, "%s: req_frame_rate: %llu line time: %d, frame_length:%llu  \n",
-			 __func__, req_frame_rate, priv->line_time, frame_length);
+    ctrls->vblank = v4l2_ctrl_new_std(
+        &ctrls->handler,
+        &imx547_ctrl_ops,
+        V4L2_CID_VBLANK, 0, INT_MAX, 1, 0);
 
-    err = imx547_set_frame_length(priv);
-    if (err)
-        goto fail;
+    ctrls->pixel_rate = v4l2_ctrl_new_std(
+        &ctrls->handler, NULL,
+        V4L2_CID_PIXEL_RATE, IMX547_PIXEL_RATE,
+        IMX547_PIXEL_RATE, 1, IMX547_PIXEL_RATE);
 
-    return 0;
+    ctrls->link_freq = v4l2_ctrl_new_int_menu(
+        &ctrls->handler, NULL,
+        V4L2_CID_LINK_FREQ,
+        ARRAY_SIZE(imx547_link_freqs) - 1, 0, imx547_link_freqs);
 
-fail:
-    dev_err(&priv->client->dev, "%s error = %d\n", __func__, err);
-    return err;
-}
+    if (ctrls->handler.error) {
+        ret = ctrls->handler.error;
+        goto fail;
+    }
 
-static const struct v4l2_subdev_pad_ops imx547_pad_ops = {
-    .get_fmt = imx547_get_fmt,
-    .set_fmt = imx547_set_fmt,
-    .get_frame_interval = imx547_g_frame_interval,
-    .set_frame_interval = imx547_s_frame_interval,
-};
+    ctrls->hblank->flags |= V4L2_CTRL_FLAG_READ_ONLY;
+    ctrls->link_freq->flags |= V4L2_CTRL_FLAG_READ_ONLY;
 
-static const struct v4l2_subdev_video_ops imx547_video_ops = {
-    .s_stream = imx547_s_stream,
-};
+    /* exposure, gain, black level and VBLANK are committed together */
+    v4l2_ctrl_cluster(4, &ctrls->exposure);
 
-static const struct v4l2_subdev_ops imx547_subdev_ops = {
-    .pad = &imx547_pad_ops,
-    .video = &imx547_video_ops,
-};
+    /* blanking and exposure range follow the default mode and frame rate */
+    mutex_lock(&priv->lock);
+    ret = imx547_update_blanking(priv);
+    if (!ret)
+        ret = imx547_update_exposure_range(priv);
+    mutex_unlock(&priv->lock);
+    if (ret)
+        goto fail;
 
-static const struct v4l2_ctrl_ops imx547_ctrl_ops = {
-    .s_ctrl = imx547_s_ctrl,
-};
+    priv->sd.ctrl_handler = &ctrls->handler;
+
+    return 0;
 
+fail:
+    v4l2_ctrl_handler_free(&ctrls->handler);
+    return ret;
+}
 
 static int imx547_probe(struct i2c_client *client)
 {
+    ktime_t probe_ts = ktime_get();
     struct v4l2_subdev *sd;
     struct stimx547 *imx547;
+    unsigned int val;
     int ret;
 
     /* initialize imx547 */
@@ -1004,16 +3783,12 @@ static int imx547_probe(struct i2c_client *client)
         return -ENOMEM;
 
     mutex_init(&imx547->lock);
+    INIT_DELAYED_WORK(&imx547->standby_work, imx547_standby_work);
+    INIT_DELAYED_WORK(&imx547->start_work, imx547_start_work);
+    INIT_WORK(&imx547->queue_work, imx547_queue_work);
 
     /* initialize format */
-    imx547->format.width = IMX547_DEFAULT_WIDTH;
-    imx547->format.height = IMX547_DEFAULT_HEIGHT;
-    imx547->format.field = V4L2_FIELD_NONE;
-    imx547->format.code = MEDIA_BUS_FMT_SRGGB12_1X12;
-    imx547->format.colorspace = V4L2_COLORSPACE_SRGB;
-    imx547->frame_interval.numerator = 1;
-    imx547->frame_interval.denominator = IMX547_DEF_FRAME_RATE;
-    imx547->frame_length = IMX547_DEFAULT_HEIGHT + IMX547_MIN_FRAME_DELTA;
+    imx547_init_defaults(imx547);
 
     /* initialize regmap */
     imx547->regmap = devm_regmap_init_i2c(client, &imx547_regmap_config);
@@ -1028,12 +3803,14 @@ static int imx547_probe(struct i2c_client *client)
     imx547->client = client;
     sd = &imx547->sd;
     v4l2_i2c_subdev_init(sd, client, &imx547_subdev_ops);
+    sd->internal_ops = &imx547_internal_ops;
     sd->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE | V4L2_SUBDEV_FL_HAS_EVENTS;
 
-    /* initialize subdev media pad */
-    imx547->pad.flags = MEDIA_PAD_FL_SOURCE;
+    /* initialize subdev media pads */
+    imx547->pads[IMX547_PAD_IMAGE].flags = MEDIA_PAD_FL_SOURCE;
+    imx547->pads[IMX547_PAD_FINFO].flags = MEDIA_PAD_FL_SOURCE;
     sd->entity.function = MEDIA_ENT_F_CAM_SENSOR;
-    ret = media_entity_pads_init(&sd->entity, 1, &imx547->pad);
+    ret = media_entity_pads_init(&sd->entity, IMX547_NUM_PADS, imx547->pads);
     if (ret < 0) {
         dev_err(&client->dev,
             "%s : media entity init Failed %d\n", __func__, ret);
@@ -1061,70 +3838,119 @@ static int imx547_probe(struct i2c_client *client)
     }
     gpiod_set_value_cansleep(imx547->pipe_reset_gpio, 0);
 
-    /* initialize controls */
-    ret = v4l2_ctrl_handler_init(&imx547->ctrls.handler, 3);
-    if (ret < 0) {
-        dev_err(&client->dev,
-            "%s : ctrl handler init Failed\n", __func__);
+    /* initialize optional GT link ready gpio */
+    imx547->link_ready_gpio = devm_gpiod_get_optional(&client->dev, "link-ready",
+                              GPIOD_IN);
+    if (IS_ERR(imx547->link_ready_gpio)) {
+        if (PTR_ERR(imx547->link_ready_gpio) != -EPROBE_DEFER)
+            dev_err(&client->dev, "Link ready GPIO not setup in DT");
+        ret = PTR_ERR(imx547->link_ready_gpio);
         goto err_me;
     }
 
-    imx547->ctrls.handler.lock = &imx547->lock;
-
-    /* add new controls */
-    imx547->ctrls.test_pattern = v4l2_ctrl_new_std_menu_items(
-        &imx547->ctrls.handler, &imx547_ctrl_ops,
-        V4L2_CID_TEST_PATTERN,
-        ARRAY_SIZE(tp_qmenu) - 1, 0, 0, tp_qmenu);
-
-    imx547->ctrls.gain = v4l2_ctrl_new_std(
-        &imx547->ctrls.handler,
-        &imx547_ctrl_ops,
-        V4L2_CID_GAIN, IMX547_MIN_GAIN,
-        IMX547_MAX_GAIN, 1,
-        IMX547_DEF_GAIN);
+    /* initialize optional sensor XCLR gpio, released */
+    imx547->xclr_gpio = devm_gpiod_get_optional(&client->dev, "xclr",
+                            GPIOD_OUT_LOW);
+    if (IS_ERR(imx547->xclr_gpio)) {
+        if (PTR_ERR(imx547->xclr_gpio) != -EPROBE_DEFER)
+            dev_err(&client->dev, "XCLR GPIO not setup in DT");
+        ret = PTR_ERR(imx547->xclr_gpio);
+        goto err_me;
+    }
 
-    imx547->ctrls.exposure = v4l2_ctrl_new_std(
-        &imx547->ctrls.handler,
-        &imx547_ctrl_ops,
-        V4L2_CID_EXPOSURE, IMX547_MIN_EXPOSURE_TIME,
-        IMX547_M_FACTOR / IMX547_DEF_FRAME_RATE, 1,
-        IMX547_DEF_EXPOSURE_TIME);
+    if (imx547->xclr_gpio)
+        fsleep(IMX547_XCLR_DELAY_US);
 
-    imx547->ctrls.black_level = v4l2_ctrl_new_std(
-        &imx547->ctrls.handler,
-        &imx547_ctrl_ops,
-        V4L2_CID_BLACK_LEVEL, IMX547_MIN_BLACK_LEVEL,
-        IMX547_MAX_BLACK_LEVEL_10BIT, 1,
-        IMX547_DEF_BLACK_LEVEL_10BIT);
+    /* initialize optional frame start interrupt from the sensor XVS */
+    imx547->xvs_gpio = devm_gpiod_get_optional(&client->dev, "xvs", GPIOD_IN);
+    if (IS_ERR(imx547->xvs_gpio)) {
+        if (PTR_ERR(imx547->xvs_gpio) != -EPROBE_DEFER)
+            dev_err(&client->dev, "XVS GPIO not setup in DT");
+        ret = PTR_ERR(imx547->xvs_gpio);
+        goto err_me;
+    }
 
-    imx547->sd.ctrl_handler = &imx547->ctrls.handler;
-    if (imx547->ctrls.handler.error) {
-        ret = imx547->ctrls.handler.error;
-        goto err_ctrls;
+    if (imx547->xvs_gpio) {
+        ret = gpiod_to_irq(imx547->xvs_gpio);
+        if (ret < 0) {
+            dev_err(&client->dev, "XVS GPIO has no interrupt: %d\n", ret);
+            goto err_me;
+        }
+        imx547->xvs_irq = ret;
+
+        /* XVS is an active low pulse at each frame start */
+        ret = devm_request_any_context_irq(&client->dev, imx547->xvs_irq,
+                           imx547_xvs_irq,
+                           IRQF_TRIGGER_FALLING,
+                           "imx547-xvs", imx547);
+        if (ret < 0) {
+            dev_err(&client->dev, "unable to request XVS irq: %d\n", ret);
+            goto err_me;
+        }
     }
 
-    /* setup default controls */
-    ret = v4l2_ctrl_handler_setup(&imx547->ctrls.handler);
+    /* single read to check the sensor answers, it also seeds the cache */
+    ret = regmap_read(imx547->regmap, STANDBY, &val);
     if (ret) {
-        dev_err(&client->dev,
-            "Error %d setup default controls\n", ret);
-        goto err_ctrls;
+        dev_err(&client->dev, "sensor not responding: %d\n", ret);
+        ret = -ENODEV;
+        goto err_me;
     }
 
+    imx547_parse_budgets(imx547);
+    imx547_parse_trigger_latency(imx547);
+
+    ret = imx547_parse_lanes(imx547);
+    if (ret)
+        goto err_me;
+
+    /* replace built-in tables with an optional mode pack */
+    imx547_load_mode_pack(imx547);
+
+    /* line timing depends on the mode pack and the lane count */
+    imx547->hmax = imx547_min_hmax(imx547, imx547->mode,
+                       imx547->format.width);
+    imx547->frame_length = imx547_timing_vmax(imx547->hmax,
+                          &imx547->frame_interval);
+
+    /* initialize controls */
+    ret = imx547_init_controls(imx547);
+    if (ret)
+        goto err_me;
+
+    /*
+     * Default control values are written on the first stream on, the
+     * control block starts out dirty.
+     */
+
+    /* sensor is powered, suspend once idle, keep warm standby by default */
+    pm_runtime_set_active(&client->dev);
+    pm_runtime_enable(&client->dev);
+    pm_runtime_set_autosuspend_delay(&client->dev,
+                     max_t(unsigned int, IMX547_DEF_AUTOSUSPEND_MS,
+                           warm_standby_ms));
+    pm_runtime_use_autosuspend(&client->dev);
+
     /* register subdevice */
     ret = v4l2_async_register_subdev(sd);
     if (ret < 0) {
         dev_err(&client->dev,
             "%s : v4l2_async_register_subdev failed %d\n",
             __func__, ret);
-        goto err_ctrls;
+        goto err_pm;
     }
 
-    dev_info(&client->dev, "imx547 : imx547 probe success !\n");
+    pm_runtime_idle(&client->dev);
+
+    imx547_debugfs_init(imx547);
+
+    dev_info(&client->dev, "imx547 : imx547 probe success in %lld us\n",
+         ktime_us_delta(ktime_get(), probe_ts));
     return 0;
 
-err_ctrls:
+err_pm:
+    pm_runtime_disable(&client->dev);
+    pm_runtime_set_suspended(&client->dev);
     v4l2_ctrl_handler_free(&imx547->ctrls.handler);
 err_me:
     media_entity_cleanup(&sd->entity);
@@ -1138,15 +3964,33 @@ static void imx547_remove(struct i2c_client *client)
     struct v4l2_subdev *sd = i2c_get_clientdata(client);
     struct stimx547 *imx547 = to_imx547(sd);
 
-    /* stop stream */
-    imx547_stop_stream(imx547);
+    /* stop stream and leave the sensor in full standby */
+    mutex_lock(&imx547->lock);
+    imx547->start_pending = false;
+    imx547->queue_len = 0;
+    imx547_queue_stop(imx547);
+    mutex_unlock(&imx547->lock);
+    cancel_work_sync(&imx547->queue_work);
+    cancel_delayed_work_sync(&imx547->start_work);
+
+    pm_runtime_disable(&client->dev);
+    if (!pm_runtime_status_suspended(&client->dev))
+        imx547_runtime_suspend(&client->dev);
+    pm_runtime_set_suspended(&client->dev);
+    pm_runtime_dont_use_autosuspend(&client->dev);
 
+    debugfs_remove_recursive(imx547->debugfs);
     v4l2_async_unregister_subdev(sd);
     v4l2_ctrl_handler_free(&imx547->ctrls.handler);
     media_entity_cleanup(&sd->entity);
     mutex_destroy(&imx547->lock);
 }
 
+static const struct dev_pm_ops imx547_pm_ops = {
+    SYSTEM_SLEEP_PM_OPS(imx547_suspend, imx547_resume)
+    RUNTIME_PM_OPS(imx547_runtime_suspend, imx547_runtime_resume, NULL)
+};
+
 static const struct i2c_device_id imx547_id[] = {
     { "imx547", 0 },
     { }
@@ -1158,6 +4002,8 @@ static struct i2c_driver imx547_i2c_driver = {
     .driver = {
         .name   = "imx547",
         .of_match_table = imx547_of_match,
+        .pm = pm_ptr(&imx547_pm_ops),
+        .probe_type = PROBE_PREFER_ASYNCHRONOUS,
     },
     .probe      = imx547_probe,
     .remove     = imx547_remove,
@@ -1169,3 +4015,7 @@ module_i2c_driver(imx547_i2c_driver);
 MODULE_AUTHOR("FRAMOS GmbH");
 MODULE_DESCRIPTION("IMX547 CMOS Image Sensor driver");
 MODULE_LICENSE("GPL v2");
+
+#ifdef IMX547_KUNIT_TEST
+#include "imx547_test.c"
+#endif
@@ -78,11 +78,24 @@
 #define SHS_MID             0x3241
 #define SHS_HIGH            0x3242
 
+#define FID0_ROI            0x3300
+#define FID0_ROIPH1_LOW     0x3310
+#define FID0_ROIPH1_HIGH    0x3311
+#define FID0_ROIPV1_LOW     0x3312
+#define FID0_ROIPV1_HIGH    0x3313
+#define FID0_ROIWH1_LOW     0x3314
+#define FID0_ROIWH1_HIGH    0x3315
+#define FID0_ROIWV1_LOW     0x3316
+#define FID0_ROIWV1_HIGH    0x3317
+
 #define TRIGMODE            0x3400
 #define ODBIT               0x3430
 #define SYNCSEL             0x343C
 #define STBSLVS             0x3444
 
+/* STBSLVS: one standby bit per SLVS-EC lane */
+#define IMX547_STBSLVS_LANES        0xFF
+
 #define GAIN_RTS            0x3502
 #define GAIN_LOW            0x3514
 #define GAIN_HIGH           0x3515
@@ -90,6 +103,9 @@
 #define BLKLEVEL_HIGH       0x35B5
 
 #define LANESEL             0x3904
+
+/* LANESEL: log2 of the number of SLVS-EC lanes */
+#define IMX547_MAX_LANES            8
 #define IDLECODE1_LOW       0x3934 
 #define IDLECODE1_HIGH      0x3935 
 #define IDLECODE2_LOW       0x3936 
@@ -108,382 +124,282 @@
 #define IMX547_DEFAULT_WIDTH        2472
 #define IMX547_DEFAULT_HEIGHT       2064
 
-/**
- * Special values for the write table function
- */
-#define IMX547_TABLE_WAIT_MS 0
-#define IMX547_TABLE_END     1
-#define IMX547_WAIT_MS       10
-
-#define IMX547_MIN_FRAME_DELTA  144
-
-#define IMX547_TO_LOW_BYTE(x) (x & 0xFF)
-#define IMX547_TO_MID_BYTE(x) (x >> 8)
-
 /*
- * imx547 I2C operation related structure
+ * imx547 I2C operation related structures
+ *
+ * Tables are stored as runs of consecutive registers, so each run can go
+ * out as a single bulk write. Run lengths are derived at compile time.
  */
-struct reg_8 {
+struct imx547_reg_run {
     u16 addr;
-    u8 val;
+    u16 len;
+    const u8 *vals;
+};
+
+struct imx547_reg_table {
+    const struct imx547_reg_run *runs;
+    unsigned int num_runs;
 };
 
-typedef struct reg_8 imx547_reg;
+#define IMX547_RUN(_addr, ...) {                                \
+    .addr = (_addr),                                            \
+    .len = sizeof((const u8[]){ __VA_ARGS__ }),                 \
+    .vals = (const u8[]){ __VA_ARGS__ },                        \
+}
+
+#define IMX547_REG_TABLE(_runs) {                               \
+    .runs = (_runs),                                            \
+    .num_runs = ARRAY_SIZE(_runs),                              \
+}
 
 /**
  * Tables for the write table function
  */
 
-static const imx547_reg imx547_stop[] = {
-
-    {STANDBY,              0x01},
-    {IMX547_TABLE_WAIT_MS, IMX547_WAIT_MS},
-    {XMSTA,                0x01},
-
-    {IMX547_TABLE_WAIT_MS, 30},
-    {IMX547_TABLE_END,     0x00}
+static const struct imx547_reg_run imx547_10bit_mode_runs[] = {
+    IMX547_RUN(GMRWT,          0x08, 0x32),
+    IMX547_RUN(GAINDLY,        0x02, 0x08),
+
+    IMX547_RUN(ADBIT,          0x05),
+    IMX547_RUN(ODBIT,          0x00),
+
+    IMX547_RUN(0x35A4,         0x1C),
+    IMX547_RUN(0x35A8,         0x1C),
+    IMX547_RUN(0x35EC,         0x1C),
+
+    IMX547_RUN(0x362C,         0x1C),
+    IMX547_RUN(0x362E,         0xEB, 0x1F),
+    IMX547_RUN(0x3654,         0x1C),
+    IMX547_RUN(0x3656,         0xEB, 0x1F),
+    IMX547_RUN(0x367C,         0x1C),
+    IMX547_RUN(0x367E,         0xEB, 0x1F),
+    IMX547_RUN(0x36E8,         0x11),
+
+    IMX547_RUN(0x4056,         0x0F),
+    IMX547_RUN(0x4096,         0x0F),
+
+    IMX547_RUN(0x4460,         0x6C),
+
+    IMX547_RUN(0x45E6,         0x53),
+    IMX547_RUN(0x45F0,         0x90),
+    IMX547_RUN(0x45F2,         0x8A),
+    IMX547_RUN(0x45F8,         0x8E),
+    IMX547_RUN(0x45FA,         0x90),
+
+    IMX547_RUN(0x4604,         0x8E),
+    IMX547_RUN(0x4606,         0x90),
+    IMX547_RUN(0x460C,         0x8A),
+    IMX547_RUN(0x460E,         0xBB),
+    IMX547_RUN(0x4614,         0x90),
+    IMX547_RUN(0x4616,         0x8A),
+    IMX547_RUN(0x4634,         0x4A),
+    IMX547_RUN(0x4636,         0x90),
+    IMX547_RUN(0x463C,         0x4C),
+    IMX547_RUN(0x463E,         0x92),
+    IMX547_RUN(0x4644,         0x4E),
+    IMX547_RUN(0x4646,         0x94),
+    IMX547_RUN(0x464C,         0x47),
+    IMX547_RUN(0x464E,         0x4D),
+    IMX547_RUN(0x4654,         0x49),
+    IMX547_RUN(0x4656,         0x50),
+    IMX547_RUN(0x465C,         0x4B),
+    IMX547_RUN(0x465E,         0x52),
+    IMX547_RUN(0x466A,         0x9E),
+    IMX547_RUN(0x4670,         0x98),
+    IMX547_RUN(0x4676,         0x96),
+    IMX547_RUN(0x4678,         0xBA),
+    IMX547_RUN(0x4698,         0x93),
+    IMX547_RUN(0x469A,         0xB9),
+
+    IMX547_RUN(0x4728,         0xD4, 0x0E),
+    IMX547_RUN(0x472E,         0x05, 0x04, 0x04, 0x04),
+
+    IMX547_RUN(0x4900,         0x64),
+    IMX547_RUN(0x4908,         0x6E),
 };
 
-static const imx547_reg imx547_10bit_mode[] = {
-
-    {HMAX_LOW,      IMX547_TO_LOW_BYTE(274)}, 
-    {HMAX_HIGH,     IMX547_TO_MID_BYTE(274)}, 
-    {VMAX_LOW,      IMX547_TO_LOW_BYTE(2216)}, 
-    {VMAX_MID,      IMX547_TO_MID_BYTE(2216)}, 
-
-    {GMRWT,     0x08},
-    {GMTWT,     0x32},
-    {GAINDLY,   0x02},
-    {GSDLY,     0x08},
-
-    {ADBIT,     0x05},
-    {ODBIT,     0x00},
-
-    {0x35A4,    0x1C},
-    {0x35A8,    0x1C},
-    {0x35EC,    0x1C},
-
-    {0x362C,    0x1C},
-    {0x362E,    0xEB},
-    {0x362F,    0x1F},
-    {0x3654,    0x1C},
-    {0x3656,    0xEB},
-    {0x3657,    0x1F},
-    {0x367C,    0x1C},
-    {0x367E,    0xEB},
-    {0x367F,    0x1F},
-    {0x36E8,    0x11},
-
-    {0x4056,    0x0F},
-    {0x4096,    0x0F},
-
-    {0x4460,    0x6C},
-
-    {0x45E6,    0x53},
-    {0x45F0,    0x90},
-    {0x45F2,    0x8A},
-    {0x45F8,    0x8E},
-    {0x45FA,    0x90},
-
-
-    {0x4604,    0x8E},
-    {0x4606,    0x90},
-    {0x460C,    0x8A},
-    {0x460E,    0xBB},
-    {0x4614,    0x90},
-    {0x4616,    0x8A},
-    {0x4634,    0x4A},
-    {0x4636,    0x90},
-    {0x463C,    0x4C},
-    {0x463E,    0x92},
-    {0x4644,    0x4E},
-    {0x4646,    0x94},
-    {0x464C,    0x47},
-    {0x464E,    0x4D},
-    {0x4654,    0x49},
-    {0x4656,    0x50},
-    {0x465C,    0x4B},
-    {0x465E,    0x52},
-    {0x466A,    0x9E},
-    {0x4670,    0x98},
-    {0x4676,    0x96},
-    {0x4678,    0xBA},
-    {0x4698,    0x93},
-    {0x469A,    0xB9},
-
-    {0x4728,    0xD4},
-    {0x4729,    0x0E},
-    {0x472E,    0x05},
-    {0x472F,    0x04},
-    {0x4730,    0x04},
-    {0x4731,    0x04},
-
-    {0x4900,    0x64},
-    {0x4908,    0x6E},
-
-    {IMX547_TABLE_WAIT_MS, IMX547_WAIT_MS},
-    {IMX547_TABLE_END,     0x00}
+static const struct imx547_reg_table imx547_10bit_mode =
+    IMX547_REG_TABLE(imx547_10bit_mode_runs);
+
+static const struct imx547_reg_run imx547_12bit_mode_runs[] = {
+    IMX547_RUN(GMRWT,          0x06, 0x24),
+    IMX547_RUN(GAINDLY,        0x02, 0x10),
+
+    IMX547_RUN(ADBIT,          0x15),
+    IMX547_RUN(ODBIT,          0x01),
+
+    IMX547_RUN(0x35A4,         0x08),
+    IMX547_RUN(0x35A8,         0x08),
+    IMX547_RUN(0x35EC,         0x08),
+
+    IMX547_RUN(0x362C,         0x64),
+    IMX547_RUN(0x362E,         0x00, 0x00),
+    IMX547_RUN(0x3654,         0x64),
+    IMX547_RUN(0x3656,         0x20, 0x00),
+    IMX547_RUN(0x367C,         0x64),
+    IMX547_RUN(0x367E,         0x00, 0x00),
+    IMX547_RUN(0x36E8,         0x13),
+
+    IMX547_RUN(0x4056,         0x23),
+    IMX547_RUN(0x4096,         0x23),
+
+    IMX547_RUN(0x4460,         0x6E),
+
+    IMX547_RUN(0x45E6,         0x3F),
+    IMX547_RUN(0x45F0,         0x95),
+    IMX547_RUN(0x45F2,         0x8F),
+    IMX547_RUN(0x45F8,         0x93),
+    IMX547_RUN(0x45FA,         0x95),
+
+    IMX547_RUN(0x4604,         0x93),
+    IMX547_RUN(0x4606,         0x95),
+    IMX547_RUN(0x460C,         0x8F),
+    IMX547_RUN(0x460E,         0xC0),
+    IMX547_RUN(0x4614,         0x95),
+    IMX547_RUN(0x4616,         0x8F),
+    IMX547_RUN(0x4634,         0x36),
+    IMX547_RUN(0x4636,         0x95),
+    IMX547_RUN(0x463C,         0x38),
+    IMX547_RUN(0x463E,         0x97),
+    IMX547_RUN(0x4644,         0x3A),
+    IMX547_RUN(0x4646,         0x99),
+    IMX547_RUN(0x464C,         0x33),
+    IMX547_RUN(0x464E,         0x39),
+    IMX547_RUN(0x4654,         0x35),
+    IMX547_RUN(0x4656,         0x3C),
+    IMX547_RUN(0x465C,         0x37),
+    IMX547_RUN(0x465E,         0x3E),
+    IMX547_RUN(0x466A,         0xA3),
+    IMX547_RUN(0x4670,         0x9D),
+    IMX547_RUN(0x4676,         0x9B),
+    IMX547_RUN(0x4678,         0xBF),
+    IMX547_RUN(0x4698,         0x98),
+    IMX547_RUN(0x469A,         0xBE),
+
+    IMX547_RUN(0x4728,         0xFB, 0x07),
+    IMX547_RUN(0x472E,         0x06, 0x06, 0x06, 0x06),
+
+    IMX547_RUN(0x4900,         0x6C),
+    IMX547_RUN(0x4908,         0x68),
 };
 
-static const imx547_reg imx547_12bit_mode[] = {
-
-    {HMAX_LOW,      IMX547_TO_LOW_BYTE(408)}, 
-    {HMAX_HIGH,     IMX547_TO_MID_BYTE(408)}, 
-    {VMAX_LOW,      IMX547_TO_LOW_BYTE(2208)}, 
-    {VMAX_MID,      IMX547_TO_MID_BYTE(2208)}, 
-
-    {GMRWT,     0x06},
-    {GMTWT,     0x24},
-    {GAINDLY,   0x02},
-    {GSDLY,     0x10},
-
-    {ADBIT,     0x15},
-    {ODBIT,     0x01},
-
-    {0x35A4,    0x08},
-    {0x35A8,    0x08},
-    {0x35EC,    0x08},
-
-    {0x362C,    0x64},
-    {0x362E,    0x00},
-    {0x362F,    0x00},
-    {0x3654,    0x64},
-    {0x3656,    0x20},
-    {0x3657,    0x00},
-    {0x367C,    0x64},
-    {0x367E,    0x00},
-    {0x367F,    0x00},
-    {0x36E8,    0x13},
-
-    {0x4056,    0x23},
-    {0x4096,    0x23},
-
-    {0x4460,    0x6E},
-
-    {0x45E6,    0x3F},
-    {0x45F0,    0x95},
-    {0x45F2,    0x8F},
-    {0x45F8,    0x93},
-    {0x45FA,    0x95},
-
-
-    {0x4604,    0x93},
-    {0x4606,    0x95},
-    {0x460C,    0x8F},
-    {0x460E,    0xC0},
-    {0x4614,    0x95},
-    {0x4616,    0x8F},
-    {0x4634,    0x36},
-    {0x4636,    0x95},
-    {0x463C,    0x38},
-    {0x463E,    0x97},
-    {0x4644,    0x3A},
-    {0x4646,    0x99},
-    {0x464C,    0x33},
-    {0x464E,    0x39},
-    {0x4654,    0x35},
-    {0x4656,    0x3C},
-    {0x465C,    0x37},
-    {0x465E,    0x3E},
-    {0x466A,    0xA3},
-    {0x4670,    0x9D},
-    {0x4676,    0x9B},
-    {0x4678,    0xBF},
-    {0x4698,    0x98},
-    {0x469A,    0xBE},
-
-    {0x4728,    0xFB},
-    {0x4729,    0x07},
-    {0x472E,    0x06},
-    {0x472F,    0x06},
-    {0x4730,    0x06},
-    {0x4731,    0x06},
-
-    {0x4900,    0x6C},
-    {0x4908,    0x68},
-
-    {IMX547_TABLE_WAIT_MS, IMX547_WAIT_MS},
-    {IMX547_TABLE_END,     0x00}
+static const struct imx547_reg_table imx547_12bit_mode =
+    IMX547_REG_TABLE(imx547_12bit_mode_runs);
+
+static const struct imx547_reg_run imx547_common_settings_runs[] = {
+    IMX547_RUN(FREQ,           0x00),
+    IMX547_RUN(INCKSEL_ST0,    0x0A, 0x22, 0xB1),
+    IMX547_RUN(INCKSEL_ST3,    0x40, 0x04),
+    IMX547_RUN(INCKSEL_ST5,    0x3A),
+
+    IMX547_RUN(INCKSEL_N0,     0x80, 0x05, 0xE0, 0x00, 0x80, 0x05, 0xE0, 0x00,
+                               0x10, 0x14, 0x20, 0xC0),
+
+    IMX547_RUN(SLVS_EN,        0x02),
+    IMX547_RUN(LLBLANK_LOW,    0x19),
+    IMX547_RUN(VINT_EN,        0x33),
+    IMX547_RUN(CRC_ECC_MODE,   0xD1),
+    IMX547_RUN(IDLECODE1_LOW,  0x3C, 0x01, 0xBC, 0x01, 0x3C, 0x01, 0x3C, 0x01),
+
+    IMX547_RUN(HVMODE,         0x03),
+
+    IMX547_RUN(GAIN_RTS,       0x09),
+    IMX547_RUN(SYNCSEL,        0xF0),
+
+    IMX547_RUN(0x3004,         0xA8, 0x02),
+
+    IMX547_RUN(0x3233,         0x00),
+
+    IMX547_RUN(0x3521,         0x3D),
+    IMX547_RUN(0x3535,         0x00),
+    IMX547_RUN(0x3542,         0x27),
+    IMX547_RUN(0x3546,         0x0F),
+    IMX547_RUN(0x354A,         0x20),
+    IMX547_RUN(0x359C,         0x0F, 0x02),
+    IMX547_RUN(0x35A5,         0x12),
+    IMX547_RUN(0x35A9,         0x62),
+    IMX547_RUN(0x35CE,         0x0E),
+    IMX547_RUN(0x35ED,         0x12),
+    IMX547_RUN(0x35F0,         0xFB, 0x0B, 0xFB, 0x0B),
+
+    IMX547_RUN(0x3642,         0x10),
+    IMX547_RUN(0x366A,         0x2E),
+    IMX547_RUN(0x3670,         0xC3),
+    IMX547_RUN(0x3672,         0x05),
+    IMX547_RUN(0x3674,         0xB6, 0x01, 0x05),
+    IMX547_RUN(0x3692,         0x10),
+    IMX547_RUN(0x36F5,         0x0F),
+
+    IMX547_RUN(0x3797,         0x20),
+
+    IMX547_RUN(0x3E2E,         0x07),
+    IMX547_RUN(0x3E30,         0x4E),
+    IMX547_RUN(0x3E6E,         0x07),
+    IMX547_RUN(0x3E70,         0x35),
+    IMX547_RUN(0x3E96,         0x01),
+    IMX547_RUN(0x3E9E,         0x38),
+    IMX547_RUN(0x3EA0,         0x4C),
+
+    IMX547_RUN(0x3F3A,         0x04),
+
+    IMX547_RUN(0x4182,         0x00),
+    IMX547_RUN(0x41A2,         0x03),
+
+    IMX547_RUN(0x4232,         0x3C),
+    IMX547_RUN(0x4235,         0x22),
+
+    IMX547_RUN(0x4306,         0x00, 0x00, 0x00, 0x00),
+    IMX547_RUN(0x4310,         0x04, 0x04, 0x04, 0x04),
+    IMX547_RUN(0x431E,         0x16, 0x16),
+    IMX547_RUN(0x433C,         0x8A, 0x02, 0xE8, 0x05, 0x9E, 0x0C),
+
+    IMX547_RUN(0x446A,         0x4C),
+    IMX547_RUN(0x446E,         0x51),
+    IMX547_RUN(0x4472,         0x57),
+    IMX547_RUN(0x4476,         0x79),
+    IMX547_RUN(0x448A,         0x4C),
+    IMX547_RUN(0x448E,         0x51),
+    IMX547_RUN(0x4492,         0x57),
+    IMX547_RUN(0x4496,         0x79),
+    IMX547_RUN(0x44EC,         0x3F),
+    IMX547_RUN(0x44F0,         0x44),
+    IMX547_RUN(0x44F4,         0x4A),
+
+    IMX547_RUN(0x4510,         0x3F),
+    IMX547_RUN(0x4514,         0x44),
+    IMX547_RUN(0x4518,         0x4A),
+    IMX547_RUN(0x4576,         0xBE),
+    IMX547_RUN(0x457A,         0xB1),
+    IMX547_RUN(0x4580,         0xBC),
+    IMX547_RUN(0x4584,         0xAF),
+
+    IMX547_RUN(0x473C,         0x06, 0x06, 0x06, 0x06),
+    IMX547_RUN(0x4749,         0x9F, 0x99, 0x09),
+    IMX547_RUN(0x4753,         0x90, 0x99, 0x09),
+    IMX547_RUN(0x4788,         0x04),
+
+    IMX547_RUN(0x4864,         0xDC),
+    IMX547_RUN(0x4868,         0xDC),
+    IMX547_RUN(0x486C,         0xDC),
+    IMX547_RUN(0x4874,         0xDC),
+    IMX547_RUN(0x4878,         0xDC),
+    IMX547_RUN(0x487C,         0xDC),
+    IMX547_RUN(0x48A4,         0xF4),
+    IMX547_RUN(0x48A8,         0xF4),
+    IMX547_RUN(0x48AC,         0xF4),
+    IMX547_RUN(0x48B4,         0xF4),
+    IMX547_RUN(0x48B8,         0xF4),
+    IMX547_RUN(0x48BC,         0xF4),
+
+    IMX547_RUN(0x4901,         0x0A, 0x01),
+    IMX547_RUN(0x4916,         0x00, 0x00, 0xFF, 0x0F),
+    IMX547_RUN(0x491E,         0xFF, 0x0F, 0x00, 0x00),
+    IMX547_RUN(0x4926,         0xFF, 0x0F, 0x00, 0x00),
+
+    IMX547_RUN(0x4A34,         0x0A),
 };
 
-static const imx547_reg imx547_common_settings[] = {
-
-    {FREQ,          0x00},
-    {INCKSEL_ST0,   0x0A},
-    {INCKSEL_ST1,   0x22},
-    {INCKSEL_ST2,   0xB1},
-    {INCKSEL_ST3,   0x40},
-    {INCKSEL_ST4,   0x04},
-    {INCKSEL_ST5,   0x3A},
-
-    {INCKSEL_N0,    0x80},
-    {INCKSEL_N1,    0x05},
-    {INCKSEL_N2,    0xE0},
-    {INCKSEL_N3,    0x00},
-
-    {INCKSEL_S0,    0x80},
-    {INCKSEL_S1,    0x05},
-    {INCKSEL_S2,    0xE0},
-    {INCKSEL_S3,    0x00},
-
-    {INCKSEL_D0,    0x10},
-    {INCKSEL_D1,    0x14},
-    {INCKSEL_D2,    0x20},
-    {INCKSEL_D3,    0xC0},
-
-    {SLVS_EN,       0x02},
-    {LLBLANK_LOW,   0x19},
-    {VINT_EN,       0x33},
-    {CRC_ECC_MODE,  0xD1},
-    {VOPB_VBLK_HWID_LOW,    0xA8},
-    {VOPB_VBLK_HWID_HIGH,   0x09},
-    {FINFO_HWIDTH_LOW,      0xA8},
-    {FINFO_HWIDTH_HIGH,     0x09},
-    {IDLECODE1_LOW,     0x3C},
-    {IDLECODE1_HIGH,    0x01},
-    {IDLECODE2_LOW,     0xBC},
-    {IDLECODE2_HIGH,    0x01},
-    {IDLECODE3_LOW,     0x3C},
-    {IDLECODE3_HIGH,    0x01},
-    {IDLECODE4_LOW,     0x3C},
-    {IDLECODE4_HIGH,    0x01},
-
-    {HVMODE,    0x03},
-    {LANESEL,   0x03},
-
-    {GAIN_RTS,  0x09},
-    {SYNCSEL,   0xF0}, 
-
-    {0x3004,    0xA8},
-    {0x3005,    0x02},
-
-    {0x3233,    0x00},
-
-    {0x3521,    0x3D},
-    {0x3535,    0x00},
-    {0x3542,    0x27},
-    {0x3546,    0x0F},
-    {0x354A,    0x20},
-    {0x359C,    0x0F},
-    {0x359D,    0x02},
-    {0x35A5,    0x12},
-    {0x35A9,    0x62},
-    {0x35CE,    0x0E},
-    {0x35ED,    0x12},
-    {0x35F0,    0xFB},
-    {0x35F1,    0x0B},
-    {0x35F2,    0xFB},
-    {0x35F3,    0x0B},
-    
-    {0x3642,    0x10},
-    {0x366A,    0x2E},
-    {0x3670,    0xC3},
-    {0x3672,    0x05},
-    {0x3674,    0xB6},
-    {0x3675,    0x01},
-    {0x3676,    0x05},
-    {0x3692,    0x10},
-    {0x36F5,    0x0F},
-    
-    {0x3797,    0x20},
-
-    {0x3E2E,    0x07},
-    {0x3E30,    0x4E},
-    {0x3E6E,    0x07},
-    {0x3E70,    0x35},
-    {0x3E96,    0x01},
-    {0x3E9E,    0x38},
-    {0x3EA0,    0x4C},
-
-    {0x3F3A,    0x04},
-
-    {0x4182,    0x00},
-    {0x41A2,    0x03},
-
-    {0x4232,    0x3C},
-    {0x4235,    0x22},
-
-    {0x4306,    0x00},
-    {0x4307,    0x00},
-    {0x4308,    0x00},
-    {0x4309,    0x00},
-    {0x4310,    0x04},
-    {0x4311,    0x04},
-    {0x4312,    0x04},
-    {0x4313,    0x04},
-    {0x431E,    0x16},
-    {0x431F,    0x16},
-    {0x433C,    0x8A},
-    {0x433D,    0x02},
-    {0x433E,    0xE8},
-    {0x433F,    0x05},
-    {0x4340,    0x9E},
-    {0x4341,    0x0C},
-
-    {0x446A,    0x4C},
-    {0x446E,    0x51},
-    {0x4472,    0x57},
-    {0x4476,    0x79},
-    {0x448A,    0x4C},
-    {0x448E,    0x51},
-    {0x4492,    0x57},
-    {0x4496,    0x79},
-    {0x44EC,    0x3F},
-    {0x44F0,    0x44},
-    {0x44F4,    0x4A},
-
-    {0x4510,    0x3F},
-    {0x4514,    0x44},
-    {0x4518,    0x4A},
-    {0x4576,    0xBE},
-    {0x457A,    0xB1},
-    {0x4580,    0xBC},
-    {0x4584,    0xAF},
-
-    {0x473C,    0x06},
-    {0x473D,    0x06},
-    {0x473E,    0x06},
-    {0x473F,    0x06},
-    {0x4749,    0x9F},
-    {0x474A,    0x99},
-    {0x474B,    0x09},
-    {0x4753,    0x90},
-    {0x4754,    0x99},
-    {0x4755,    0x09},
-    {0x4788,    0x04},
-
-    {0x4864,    0xDC},
-    {0x4868,    0xDC},
-    {0x486C,    0xDC},
-    {0x4874,    0xDC},
-    {0x4878,    0xDC},
-    {0x487C,    0xDC},
-    {0x48A4,    0xF4},
-    {0x48A8,    0xF4},
-    {0x48AC,    0xF4},
-    {0x48B4,    0xF4},
-    {0x48B8,    0xF4},
-    {0x48BC,    0xF4},
-
-    {0x4901,    0x0A},
-    {0x4902,    0x01},
-    {0x4916,    0x00},
-    {0x4917,    0x00},
-    {0x4918,    0xFF},
-    {0x4919,    0x0F},
-    {0x491E,    0xFF},
-    {0x491F,    0x0F},
-    {0x4920,    0x00},
-    {0x4921,    0x00},
-    {0x4926,    0xFF},
-    {0x4927,    0x0F},
-    {0x4928,    0x00},
-    {0x4929,    0x00},
-
-    {0x4A34,    0x0A},
-
-    {IMX547_TABLE_WAIT_MS,      IMX547_WAIT_MS},
-    {IMX547_TABLE_END,          0x0000}
-};
+static const struct imx547_reg_table imx547_common_settings =
+    IMX547_REG_TABLE(imx547_common_settings_runs);
 
 #endif /* __IMX547_TABLES__ */
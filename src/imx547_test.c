@@ -0,0 +1,129 @@
+/*
+ * imx547_test.c - KUnit tests for the imx547 driver
+ *
+ * Copyright (c) 2022. FRAMOS.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Included at the end of imx547.c when built with IMX547_KUNIT_TEST, so
+ * the tests reach the static functions. The device is set up the way
+ * probe leaves it before the first stream on. There is no regmap, a
+ * test that ends up writing a register is a bug in the test.
+ */
+
+#include <kunit/test.h>
+
+static struct stimx547 *imx547_test_alloc(struct kunit *test)
+{
+    struct stimx547 *priv;
+
+    priv = kunit_kzalloc(test, sizeof(*priv), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, priv);
+
+    priv->client = kunit_kzalloc(test, sizeof(*priv->client), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, priv->client);
+
+    mutex_init(&priv->lock);
+    imx547_init_defaults(priv);
+    priv->hmax = imx547_min_hmax(priv, priv->mode, priv->format.width);
+    priv->frame_length = imx547_timing_vmax(priv->hmax,
+                        &priv->frame_interval);
+
+    return priv;
+}
+
+static void imx547_test_free(struct stimx547 *priv)
+{
+    v4l2_ctrl_handler_free(&priv->ctrls.handler);
+    mutex_destroy(&priv->lock);
+}
+
+/* probe creates the controls with the ranges of the default mode */
+static void imx547_test_init_controls(struct kunit *test)
+{
+    struct stimx547 *priv = imx547_test_alloc(test);
+    struct imx547_ctrls *ctrls = &priv->ctrls;
+
+    KUNIT_ASSERT_EQ(test, imx547_init_controls(priv), 0);
+
+    KUNIT_EXPECT_EQ(test, ctrls->hblank->val,
+            priv->hmax * IMX547_PIXELS_PER_INCK - priv->format.width);
+    KUNIT_EXPECT_EQ(test, ctrls->vblank->val,
+            priv->frame_length - priv->format.height);
+    KUNIT_EXPECT_EQ(test, ctrls->exposure->val, IMX547_DEF_EXPOSURE_TIME);
+
+    imx547_test_free(priv);
+}
+
+/* a narrower output changes the read-only HBLANK value */
+static void imx547_test_update_blanking(struct kunit *test)
+{
+    struct stimx547 *priv = imx547_test_alloc(test);
+    struct imx547_ctrls *ctrls = &priv->ctrls;
+    int ret;
+
+    KUNIT_ASSERT_EQ(test, imx547_init_controls(priv), 0);
+
+    priv->crop.width = 1024;
+    priv->format.width = 1024;
+    priv->hmax = imx547_min_hmax(priv, priv->mode, priv->format.width);
+
+    mutex_lock(&priv->lock);
+    ret = imx547_update_blanking(priv);
+    mutex_unlock(&priv->lock);
+
+    KUNIT_EXPECT_EQ(test, ret, 0);
+    KUNIT_EXPECT_EQ(test, ctrls->hblank->val,
+            priv->hmax * IMX547_PIXELS_PER_INCK - 1024);
+    KUNIT_EXPECT_EQ(test, ctrls->vblank->val,
+            priv->frame_length - priv->format.height);
+
+    imx547_test_free(priv);
+}
+
+/* the queue delay follows GAINDLY and GSDLY of the active tables */
+static void imx547_test_queue_delay(struct kunit *test)
+{
+    struct stimx547 *priv = imx547_test_alloc(test);
+    u32 gsdly;
+
+    KUNIT_EXPECT_EQ(test, imx547_table_setting(priv, GAINDLY), 0x02);
+
+    gsdly = imx547_table_setting(priv, GSDLY);
+    KUNIT_EXPECT_EQ(test, gsdly, 0x10);
+
+    KUNIT_EXPECT_EQ(test, imx547_queue_delay(priv, priv->mode->vmax),
+            IMX547_QUEUE_MIN_DELAY);
+    KUNIT_EXPECT_EQ(test, imx547_queue_delay(priv, gsdly), 0x02 + 1);
+
+    priv->mode = &priv->modes[IMX547_MODE_10BIT];
+    KUNIT_EXPECT_EQ(test, imx547_table_setting(priv, GSDLY), 0x08);
+
+    mutex_destroy(&priv->lock);
+}
+
+static struct kunit_case imx547_test_cases[] = {
+    KUNIT_CASE(imx547_test_init_controls),
+    KUNIT_CASE(imx547_test_update_blanking),
+    KUNIT_CASE(imx547_test_queue_delay),
+    {}
+};
+
+static struct kunit_suite imx547_test_suite = {
+    .name = "imx547",
+    .test_cases = imx547_test_cases,
+};
+
+kunit_test_suite(imx547_test_suite);
@@ -0,0 +1,141 @@
+/*
+ * imx547_timing.h - imx547 sensor timing model
+ *
+ * Copyright (c) 2022. FRAMOS.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __IMX547_TIMING__
+#define __IMX547_TIMING__
+
+#include <linux/gcd.h>
+#include <linux/math64.h>
+#include <linux/time.h>
+#include <linux/videodev2.h>
+
+/*
+ * Timing in INCK clock units, as in the datasheet:
+ *
+ *   1H          = HMAX / INCK
+ *   frame       = VMAX x 1H
+ *   exposure    = (VMAX - SHS) x 1H
+ *
+ * Frame lengths and exposures are kept in lines, times are only derived
+ * from them, so converting back and forth does not drift.
+ */
+
+#define IMX547_INCK         74250000U
+
+/* SLVS-EC bytes per lane and line: start, header, footer, end and deskew */
+#define IMX547_SLVSEC_LINE_OVERHEAD 32
+
+/*
+ * imx547_timing_ns - Duration of a number of lines
+ * @hmax: Line length in INCK cycles
+ * @lines: Number of lines
+ *
+ * Return: Duration in nanoseconds, rounded to the nearest
+ */
+static inline u64 imx547_timing_ns(u32 hmax, u64 lines)
+{
+    return DIV_ROUND_CLOSEST_ULL(lines * hmax * NSEC_PER_SEC, IMX547_INCK);
+}
+
+/*
+ * imx547_timing_us - Duration of a number of lines
+ * @hmax: Line length in INCK cycles
+ * @lines: Number of lines
+ *
+ * Return: Duration in microseconds, rounded to the nearest
+ */
+static inline u32 imx547_timing_us(u32 hmax, u64 lines)
+{
+    return DIV_ROUND_CLOSEST_ULL(lines * hmax * USEC_PER_SEC, IMX547_INCK);
+}
+
+/*
+ * imx547_timing_lines - Number of lines closest to a duration
+ * @hmax: Line length in INCK cycles
+ * @us: Duration in microseconds
+ *
+ * Return: Number of lines
+ */
+static inline u32 imx547_timing_lines(u32 hmax, u32 us)
+{
+    return DIV_ROUND_CLOSEST_ULL((u64)us * IMX547_INCK,
+                     (u64)hmax * USEC_PER_SEC);
+}
+
+/*
+ * imx547_timing_vmax - Longest frame length not above a frame interval
+ * @hmax: Line length in INCK cycles
+ * @fi: Frame interval
+ *
+ * Rounds down, so the delivered frame rate never falls short of the
+ * requested one.
+ *
+ * Return: Frame length in lines
+ */
+static inline u32 imx547_timing_vmax(u32 hmax, const struct v4l2_fract *fi)
+{
+    return div64_u64((u64)fi->numerator * IMX547_INCK,
+             (u64)fi->denominator * hmax);
+}
+
+/*
+ * imx547_timing_interval - Exact frame interval of a frame length
+ * @hmax: Line length in INCK cycles
+ * @vmax: Frame length in lines
+ * @fi: Filled with the frame interval, in lowest terms
+ *
+ * The frame length in INCK cycles does not fit 32 bits for the largest
+ * HMAX and VMAX register values, so it is reduced in 64 bits. Reducing
+ * by INCK first keeps gcd() within unsigned long on 32 bit machines.
+ */
+static inline void imx547_timing_interval(u32 hmax, u32 vmax,
+                      struct v4l2_fract *fi)
+{
+    u64 cycles = (u64)vmax * hmax;
+    unsigned long div;
+    u32 rem;
+
+    div_u64_rem(cycles, IMX547_INCK, &rem);
+    div = gcd(IMX547_INCK, rem);
+
+    fi->numerator = div64_u64(cycles, div);
+    fi->denominator = IMX547_INCK / div;
+}
+
+/*
+ * imx547_timing_link_hmax - Shortest line the output link can carry
+ * @width: Output line width in pixels
+ * @bit_depth: Bits per pixel
+ * @lanes: Number of SLVS-EC lanes
+ * @link_freq: Lane bit rate in bits per second
+ *
+ * A line is split over the lanes and sent 8b/10b coded, ten bits per
+ * byte on the wire, plus the per-line packet overhead.
+ *
+ * Return: Minimum HMAX in INCK cycles
+ */
+static inline u32 imx547_timing_link_hmax(u32 width, u32 bit_depth, u32 lanes,
+                      u64 link_freq)
+{
+    u64 bytes = DIV_ROUND_UP(width * bit_depth, 8 * lanes) +
+            IMX547_SLVSEC_LINE_OVERHEAD;
+
+    return div64_u64(bytes * 10 * IMX547_INCK + link_freq - 1, link_freq);
+}
+
+#endif /* __IMX547_TIMING__ */
@@ -0,0 +1,111 @@
+/*
+ * imx547_timing_test.c - KUnit tests for the imx547 timing model
+ *
+ * Copyright (c) 2022. FRAMOS.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <kunit/test.h>
+#include <linux/module.h>
+
+#include "imx547_timing.h"
+
+/* Datasheet line lengths of the full readout modes, in INCK cycles */
+#define TEST_HMAX_10BIT     274
+#define TEST_HMAX_12BIT     408
+
+#define TEST_LINK_FREQ      2376000000ULL
+#define TEST_WIDTH          2472
+
+static void imx547_timing_test_vmax(struct kunit *test)
+{
+    struct v4l2_fract fps60 = { 1, 60 };
+    struct v4l2_fract fps2 = { 1, 2 };
+
+    KUNIT_EXPECT_EQ(test, imx547_timing_vmax(TEST_HMAX_12BIT, &fps60), 3033);
+    KUNIT_EXPECT_EQ(test, imx547_timing_vmax(TEST_HMAX_12BIT, &fps2), 90992);
+    KUNIT_EXPECT_EQ(test, imx547_timing_vmax(TEST_HMAX_10BIT, &fps2), 135492);
+}
+
+static void imx547_timing_test_interval(struct kunit *test)
+{
+    struct v4l2_fract fi;
+
+    /* 10 bit full mode at its minimum frame length, 122.29 fps */
+    imx547_timing_interval(TEST_HMAX_10BIT, 2216, &fi);
+    KUNIT_EXPECT_EQ(test, fi.numerator, 37949);
+    KUNIT_EXPECT_EQ(test, fi.denominator, 4640625);
+
+    /* 12 bit full mode at its minimum frame length, 82.42 fps */
+    imx547_timing_interval(TEST_HMAX_12BIT, 2208, &fi);
+    KUNIT_EXPECT_EQ(test, fi.numerator, 6256);
+    KUNIT_EXPECT_EQ(test, fi.denominator, 515625);
+
+    /* The frame length rounded down for 60 fps gives back just above it */
+    imx547_timing_interval(TEST_HMAX_12BIT, 3033, &fi);
+    KUNIT_EXPECT_EQ(test, fi.numerator, 5729);
+    KUNIT_EXPECT_EQ(test, fi.denominator, 343750);
+}
+
+static void imx547_timing_test_interval_overflow(struct kunit *test)
+{
+    struct v4l2_fract fi;
+
+    /* Largest register values, the product does not fit 32 bits */
+    imx547_timing_interval(0xFFFF, 0xFFFFF, &fi);
+    KUNIT_EXPECT_EQ(test, fi.numerator, 5552999);
+    KUNIT_EXPECT_EQ(test, fi.denominator, 6000);
+}
+
+static void imx547_timing_test_duration(struct kunit *test)
+{
+    KUNIT_EXPECT_EQ(test, imx547_timing_ns(TEST_HMAX_12BIT, 3033), 16666182);
+    KUNIT_EXPECT_EQ(test, imx547_timing_ns(TEST_HMAX_10BIT, 2216), 8177562);
+
+    KUNIT_EXPECT_EQ(test, imx547_timing_lines(TEST_HMAX_12BIT, 1000), 182);
+    KUNIT_EXPECT_EQ(test, imx547_timing_us(TEST_HMAX_12BIT, 182), 1000);
+}
+
+static void imx547_timing_test_link_hmax(struct kunit *test)
+{
+    KUNIT_EXPECT_EQ(test,
+            imx547_timing_link_hmax(TEST_WIDTH, 12, 8, TEST_LINK_FREQ), 155);
+    KUNIT_EXPECT_EQ(test,
+            imx547_timing_link_hmax(TEST_WIDTH, 12, 2, TEST_LINK_FREQ), 590);
+    KUNIT_EXPECT_EQ(test,
+            imx547_timing_link_hmax(TEST_WIDTH, 12, 1, TEST_LINK_FREQ), 1169);
+    KUNIT_EXPECT_EQ(test,
+            imx547_timing_link_hmax(TEST_WIDTH, 10, 8, TEST_LINK_FREQ), 131);
+    KUNIT_EXPECT_EQ(test,
+            imx547_timing_link_hmax(TEST_WIDTH, 10, 1, TEST_LINK_FREQ), 976);
+}
+
+static struct kunit_case imx547_timing_test_cases[] = {
+    KUNIT_CASE(imx547_timing_test_vmax),
+    KUNIT_CASE(imx547_timing_test_interval),
+    KUNIT_CASE(imx547_timing_test_interval_overflow),
+    KUNIT_CASE(imx547_timing_test_duration),
+    KUNIT_CASE(imx547_timing_test_link_hmax),
+    {}
+};
+
+static struct kunit_suite imx547_timing_test_suite = {
+    .name = "imx547-timing",
+    .test_cases = imx547_timing_test_cases,
+};
+
+kunit_test_suite(imx547_timing_test_suite);
+
+MODULE_DESCRIPTION("KUnit tests for the imx547 timing model");
+MODULE_LICENSE("GPL");